@@ -0,0 +1,107 @@
+#define main stfu_main
+#include "../stfu.c"
+#undef main
+#include <syslog.h>
+
+// Цена записи журнала запусков на один запуск (open + mmap + запись слота)
+// против syslog() и write + fdatasync той же записи. Затем procs процессов
+// пишут одновременно: каждая запись должна остаться целой и с уникальным
+// номером. Запускать от root: STFU_AUDIT учитывается только у root.
+//
+//   bench/audit [records] [procs] [dir]     dir по умолчанию /tmp
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char * const name, const long records, const double ns) {
+    printf("{\"bench\":\"%s\",\"records\":%ld,\"ns_per_record\":%.1f}\n", name, records, ns / records);
+}
+
+// Запуск stfu держит страницу слота до exec; здесь она снимается сразу
+static void write_record(char * const argv[]) {
+    audit_write(argv, AUDIT_FLAG_PLAN);
+    if (audit.slot) munmap((void*)((uintptr_t)audit.slot & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1)),
+                           sysconf(_SC_PAGESIZE));
+    audit.slot = NULL;
+}
+
+int main(int argc, char *argv[]) {
+    const long n = argc > 1 ? atol(argv[1]) : 20000;
+    const int procs = argc > 2 ? atoi(argv[2]) : 4;
+    const char * const dir = argc > 3 ? argv[3] : "/tmp";
+    char * const target[] = {"/usr/bin/firefox", "--new-window", NULL};
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/stfu-bench-audit.%d", dir, (int)getpid());
+    setenv("STFU_AUDIT", path, 1);
+    audit_begin(getuid());
+
+    write_record(target);
+    if (access(path, R_OK) != 0) {
+        fprintf(stderr, "bench/audit: cannot create %s (needs root)\n", path);
+        return 1;
+    }
+
+    double start = now_ns();
+    for (long i = 0; i < n; ++i) write_record(target);
+    report("audit_mmap", n, now_ns() - start);
+
+    // Та же запись строкой в syslog: без /dev/log syslog() молча теряет её
+    if (access("/dev/log", W_OK) == 0) {
+        openlog("stfu-bench", LOG_PID, LOG_AUTHPRIV);
+        start = now_ns();
+        for (long i = 0; i < n; ++i)
+            syslog(LOG_INFO, "uid=%u pid=%d flags=%u exit=%d path=%s home=%s", audit.uid, (int)getpid(), 0, 0,
+                   target[0], "/root");
+        report("syslog", n, now_ns() - start);
+        closelog();
+    } else {
+        printf("{\"bench\":\"syslog\",\"skipped\":\"no /dev/log\"}\n");
+    }
+
+    char sync_path[PATH_MAX + 8];
+    snprintf(sync_path, sizeof(sync_path), "%s.sync", path);
+    const int fd = open(sync_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    audit_record_t record = {0};
+    const long synced = n / 10 + 1;
+    start = now_ns();
+    for (long i = 0; i < synced; ++i) {
+        if (write(fd, &record, sizeof(record)) != sizeof(record) || fdatasync(fd) != 0) break;
+    }
+    report("write_fdatasync", synced, now_ns() - start);
+    close(fd);
+    unlink(sync_path);
+
+    // Одновременные запуски: слоты резервируются атомарно, без блокировок
+    unlink(path);
+    const long per_proc = n / procs;
+    start = now_ns();
+    for (int p = 0; p < procs; ++p) {
+        if (fork() == 0) {
+            for (long i = 0; i < per_proc; ++i) write_record(target);
+            _exit(0);
+        }
+    }
+    while (wait(NULL) > 0) {}
+    const double elapsed = now_ns() - start;
+
+    const int log_fd = open(path, O_RDONLY | O_CLOEXEC);
+    const audit_header_t * const header = log_fd >= 0 ? audit_map(log_fd, PROT_READ) : NULL;
+    long valid = 0;
+    const uint64_t next = header ? header->next : 0;
+    for (uint64_t seq = next > AUDIT_SLOTS ? next - AUDIT_SLOTS : 0; header && seq < next; ++seq) {
+        const audit_record_t * const r =
+            (const audit_record_t*)((const char*)header + AUDIT_RECORD * (1 + seq % AUDIT_SLOTS));
+        valid += r->seq == seq + 1 && r->argv_hash == fnv1a(fnv1a(FNV_OFFSET, target[0], strlen(target[0]) + 1),
+                                                           target[1], strlen(target[1]) + 1);
+    }
+    const long expected = per_proc * procs < AUDIT_SLOTS ? per_proc * procs : AUDIT_SLOTS;
+    printf("{\"bench\":\"audit_mmap_concurrent\",\"procs\":%d,\"records\":%ld,\"ns_per_record\":%.1f,"
+           "\"valid\":%ld,\"expected\":%ld}\n", procs, per_proc * procs, elapsed / (per_proc * procs), valid, expected);
+    unlink(path);
+
+    return valid == expected ? 0 : 1;
+}
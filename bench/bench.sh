@@ -0,0 +1,163 @@
+#!/bin/sh
+# Бенчмарк задержки запуска stfu: по одной JSON строке на сценарий.
+# Запускать от root: сценарии SUID и -s сбрасывают права до BENCH_UID.
+#
+#   make bench                      # все сценарии
+#   RUNS=1000 make bench            # больше прогонов
+#   make bench > before.json        # сравнение до/после изменений в main()
+
+STFU=${STFU:-./stfu}
+DRIVER=${DRIVER:-bench/startup}
+RUNS=${RUNS:-200}
+BENCH_UID=${BENCH_UID:-65534}
+TARGET=${TARGET:-/bin/true}
+
+WORK=$(mktemp -d /tmp/stfu-bench.XXXXXX) || exit 1
+trap 'rm -rf "$WORK"' EXIT INT TERM
+chmod 755 "$WORK"
+
+STFU=$(realpath "$STFU")
+export STFU_CACHE_DIR="$WORK/cache"
+export STFU_QUOTE_CACHE="$WORK/quotes/quotes"
+mkdir -m 755 "$STFU_CACHE_DIR"
+
+skip() {
+    printf '{"bench":"%s","skipped":"%s"}\n' "$1" "$2"
+}
+
+bench() {
+    "$DRIVER" -n "$RUNS" "$@"
+}
+
+# Базовые линии
+bench -N bare_exec -- "$TARGET"
+
+if command -v sudo >/dev/null 2>&1 && sudo -n true 2>/dev/null; then
+    bench -N sudo_exec -- sudo -n "$TARGET"
+else
+    skip sudo_exec "sudo unavailable or needs a password"
+fi
+
+# Холодный кэш: библиотека собирается заново перед каждым прогоном
+bench -N stfu_cold -w 1 -p "rm -f '$STFU_CACHE_DIR'/shim-*" -- "$STFU" "$TARGET"
+
+# Тёплый кэш
+bench -N stfu_warm -- "$STFU" "$TARGET"
+bench -N stfu_home -- "$STFU" --home "$WORK/home" "$TARGET"
+
+# Холодный кэш страниц: до первого байта вывода цели с множеством библиотек,
+# без --prefetch и с ним. Нужна запись в /proc/sys/vm/drop_caches
+COLD_TARGET=${COLD_TARGET:-/usr/bin/python3 -c print(1)}
+if [ -w /proc/sys/vm/drop_caches ] && [ -x "${COLD_TARGET%% *}" ]; then
+    drop="sync; echo 3 > /proc/sys/vm/drop_caches"
+    bench -N stfu_pagecache_cold_ready -n "$(( RUNS / 10 + 1 ))" -r -p "$drop" -- "$STFU" $COLD_TARGET
+    bench -N stfu_prefetch_cold_ready -n "$(( RUNS / 10 + 1 ))" -r -p "$drop" -- "$STFU" --prefetch $COLD_TARGET
+else
+    skip stfu_prefetch_cold_ready "needs a writable /proc/sys/vm/drop_caches and ${COLD_TARGET%% *}"
+fi
+
+# Дерево процессов как у сборки: TREE запусков из sh, в отчёте цена одного
+# процесса. --preload-scope target оставляет shim только самому sh
+TREE=${TREE:-200}
+printf 'i=0\nwhile [ $i -lt %d ]; do %s; i=$(( i + 1 )); done\n' "$TREE" "$TARGET" > "$WORK/tree.sh"
+bench -N tree_bare_per_proc -n "$(( RUNS / 10 + 1 ))" -d "$TREE" -- sh "$WORK/tree.sh"
+bench -N stfu_tree_all_per_proc -n "$(( RUNS / 10 + 1 ))" -d "$TREE" -- "$STFU" sh "$WORK/tree.sh"
+bench -N stfu_tree_target_per_proc -n "$(( RUNS / 10 + 1 ))" -d "$TREE" -- \
+    "$STFU" --preload-scope target sh "$WORK/tree.sh"
+
+# --userns: пространство имён пользователей вместо сборки и загрузки shim
+if "$STFU" --userns "$TARGET" 2>/dev/null; then
+    bench -N stfu_userns -- "$STFU" --userns "$TARGET"
+    bench -N stfu_userns_home -- "$STFU" --userns --home "$WORK/home" "$TARGET"
+else
+    skip stfu_userns "user namespaces unavailable"
+fi
+
+# --batch: подготовка один раз на BATCH задач, в отчёте цена одной задачи
+BATCH=${BATCH:-100}
+i=0
+while [ "$i" -lt "$BATCH" ]; do echo "$TARGET"; i=$(( i + 1 )); done > "$WORK/manifest"
+bench -N stfu_batch_per_job -n "$(( RUNS / 10 + 1 ))" -d "$BATCH" -- "$STFU" --batch "$WORK/manifest"
+bench -N stfu_batch_j4_per_job -n "$(( RUNS / 10 + 1 ))" -d "$BATCH" -- "$STFU" -j 4 --batch "$WORK/manifest"
+
+# -z: запуск через zygote демон против полного пути create_fake_lib (stfu_warm)
+if [ "$(id -u)" -eq 0 ]; then
+    export STFU_ZYGOTE_SOCKET="$WORK/zygote.sock"
+    "$STFU" --zygote-daemon >/dev/null 2>&1 &
+    zygote=$!
+    i=0
+    while [ ! -S "$STFU_ZYGOTE_SOCKET" ] && [ "$i" -lt 50 ]; do sleep 0.02; i=$(( i + 1 )); done
+    
+    # До exec цели (первый байт /bin/echo) и полный круг с кодом выхода
+    bench -N stfu_warm_ready -r -- "$STFU" /bin/echo
+    bench -N stfu_zygote_ready -r -- "$STFU" -z /bin/echo
+    bench -N stfu_zygote -- "$STFU" -z "$TARGET"
+    
+    kill "$zygote"
+    wait "$zygote" 2>/dev/null
+    unset STFU_ZYGOTE_SOCKET
+else
+    skip stfu_zygote "the zygote daemon needs root"
+fi
+
+# Прямой SUID: копия бинарника с битом SUID, запуск от непривилегированного пользователя
+cp "$STFU" "$WORK/stfu-suid" && chmod 4755 "$WORK/stfu-suid"
+if [ "$(id -u)" -eq 0 ] && "$DRIVER" -n 1 -w 0 -u "$BENCH_UID" -N probe -- "$WORK/stfu-suid" "$TARGET" >/dev/null; then
+    bench -N stfu_suid -u "$BENCH_UID" -- "$WORK/stfu-suid" "$TARGET"
+else
+    skip stfu_suid "needs root and a suid-capable $WORK"
+fi
+
+# -s: повторный запуск через sudo
+if [ "$(id -u)" -eq 0 ] && "$DRIVER" -n 1 -w 0 -u "$BENCH_UID" -N probe -- sudo -n true >/dev/null 2>&1; then
+    bench -N stfu_sudo -u "$BENCH_UID" -- "$STFU" -s "$TARGET"
+else
+    skip stfu_sudo "needs root and passwordless sudo for uid $BENCH_UID"
+fi
+
+# -s: второй запуск, который делает sudo, с опциями (прежний путь) против
+# готового плана. План снимает подставной sudo, печатающий свой аргумент
+if [ "$(id -u)" -eq 0 ] && command -v setpriv >/dev/null 2>&1; then
+    mkdir -m 755 "$WORK/fakesudo"
+    printf '#!/bin/sh\nprintf "%%s\\n" "$3"\n' > "$WORK/fakesudo/sudo"
+    chmod 755 "$WORK/fakesudo/sudo"
+    cp "$STFU" "$WORK/stfu-user"
+    plan=$(setpriv --reuid="$BENCH_UID" --regid="$BENCH_UID" --clear-groups env PATH="$WORK/fakesudo:$PATH" \
+           "$WORK/stfu-user" -s --user nobody -H "$WORK/home" "$TARGET")
+    bench -N stfu_sudo_stage_options -- "$WORK/stfu-user" --user nobody -H "$WORK/home" "$TARGET"
+    bench -N stfu_sudo_stage_plan -- "$WORK/stfu-user" --plan "$plan" "$TARGET"
+    
+    # --seccomp под -s: личность супервизору приходит в плане (value = 1000)
+    plan=$(setpriv --reuid="$BENCH_UID" --regid="$BENCH_UID" --clear-groups env PATH="$WORK/fakesudo:$PATH" \
+           "$WORK/stfu-user" -s --seccomp --uid 1000 --gid 1000 "$(realpath bench/rawcall)")
+    "$WORK/stfu-user" --plan "$plan" "$(realpath bench/rawcall)" stfu_sudo_seccomp
+else
+    skip stfu_sudo_stage "needs root and setpriv"
+fi
+
+# --help без сети: пустой сетевой namespace вместо реальных API
+if "$DRIVER" -n 1 -w 0 -o -N probe -- "$TARGET" >/dev/null 2>&1; then
+    LANG=C bench -N help_offline -n "$(( RUNS / 10 + 1 ))" -o -- "$STFU" --help
+else
+    skip help_offline "network namespaces unavailable"
+fi
+
+# --help против локального stand-in сервера: быстрый и медленный (500 мс) backend
+if command -v python3 >/dev/null 2>&1; then
+    for delay in 0 500; do
+        port=$(( 20000 + $$ % 10000 ))
+        python3 bench/standin.py "$port" "$delay" &
+        standin=$!
+        sleep 0.5
+        
+        STFU_QUOTE_API="http://127.0.0.1:$port/quotes" \
+        STFU_GOOGLE_API="http://127.0.0.1:$port/translate_a/single" \
+        STFU_MYMEMORY_API="http://127.0.0.1:$port/get" \
+        LANG=ru_RU.UTF-8 bench -N "help_standin_${delay}ms" -n "$(( RUNS / 10 + 1 ))" -- "$STFU" --help
+        
+        kill "$standin"
+        wait "$standin" 2>/dev/null
+    done
+else
+    skip help_standin "python3 unavailable"
+fi
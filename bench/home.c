@@ -0,0 +1,95 @@
+#define main stfu_main
+#include "../stfu.c"
+#undef main
+
+// Заполнение HOME из заготовки (--home-template) против обычного рекурсивного
+// копирования (cp -R --reflink=never): мс на заготовку из files файлов общим
+// размером mb МБ. На ФС с reflink (btrfs, XFS) provision_home не копирует данные.
+//
+//   bench/home [dir] [mb] [files]     dir по умолчанию /tmp (ФС для замера)
+
+static inline double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Заготовка как у профиля браузера: несколько больших баз и много мелких файлов
+static int make_template(const char * const root, const long mb, const long files) {
+    char path[PATH_MAX];
+    char * const chunk = malloc(1 << 20);
+    if (!chunk) return -1;
+    for (int i = 0; i < 1 << 20; ++i) chunk[i] = (char)(i * 2654435761u >> 24);
+
+    const long dirs = files / 50 + 1;
+    for (long d = 0; d < dirs; ++d) {
+        if (snprintf(path, sizeof(path), "%s/.config/app%ld/cache", root, d) >= (int)sizeof(path) ||
+            mkdir_p(path, 0755) != 0) return -1;
+    }
+
+    // 90% объёма в 4 больших файлах, остальное поровну между мелкими
+    const long small = (mb << 20) / 10 / (files > 4 ? files - 4 : 1);
+    for (long f = 0; f < files; ++f) {
+        const long size = f < 4 ? (mb << 20) * 9 / 40 : small;
+        if (snprintf(path, sizeof(path), "%s/.config/app%ld/cache/file%ld", root, f % dirs, f) >= (int)sizeof(path))
+            return -1;
+        const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return -1;
+        for (long left = size; left > 0; left -= 1 << 20) {
+            if (write_all(fd, chunk, left < 1 << 20 ? left : 1 << 20) != 0) return -1;
+        }
+        close(fd);
+    }
+
+    free(chunk);
+    return 0;
+}
+
+// Пробный reflink: показывает, на какой путь попал provision_home
+static int reflink_supported(const char * const root) {
+    char a[PATH_MAX], b[PATH_MAX];
+    if (snprintf(a, sizeof(a), "%s/.probe-a", root) >= (int)sizeof(a) ||
+        snprintf(b, sizeof(b), "%s/.probe-b", root) >= (int)sizeof(b)) return 0;
+    const int in = open(a, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    const int out = open(b, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    const int ok = in >= 0 && out >= 0 && write(in, "x", 1) == 1 && ioctl(out, FICLONE, in) == 0;
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    unlink(a);
+    unlink(b);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char * const base = argc > 1 ? argv[1] : "/tmp";
+    const long mb = argc > 2 ? atol(argv[2]) : 256;
+    const long files = argc > 3 ? atol(argv[3]) : 2000;
+
+    char root[PATH_MAX / 2], template[PATH_MAX], home[PATH_MAX], cmd[PATH_MAX * 3];
+    if (snprintf(root, sizeof(root), "%s/stfu-bench-home-%d", base, (int)getpid()) >= (int)sizeof(root)) return 1;
+    snprintf(template, sizeof(template), "%s/template", root);
+
+    if (make_template(template, mb, files) != 0) {
+        fprintf(stderr, "bench/home: cannot create %s\n", template);
+        return 1;
+    }
+    sync();
+
+    const int reflink = reflink_supported(root);
+    for (int round = 0; round < 3; ++round) {
+        snprintf(home, sizeof(home), "%s/home%d", root, round);
+        double start = now_ms();
+        const int ret = provision_home(home, template);
+        printf("{\"bench\":\"home_template\",\"mb\":%ld,\"files\":%ld,\"reflink\":%d,\"ms\":%.2f,\"ok\":%d}\n",
+               mb, files, reflink, now_ms() - start, ret == 0);
+
+        snprintf(cmd, sizeof(cmd), "cp -R --reflink=never '%s' '%s/copy%d'", template, root, round);
+        start = now_ms();
+        const int status = system(cmd);
+        printf("{\"bench\":\"recursive_copy\",\"mb\":%ld,\"files\":%ld,\"ms\":%.2f,\"ok\":%d}\n",
+               mb, files, now_ms() - start, status == 0);
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    return system(cmd) == 0 ? 0 : 1;
+}
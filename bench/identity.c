@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include <time.h>
+
+// Нагрузка на подмену личности из нескольких потоков: реентерабельные
+// варианты passwd/group, getgroups и getresuid одновременно. Каждый поток
+// проверяет ответы, поэтому гонка в shim видна как errors > 0. Запускается
+// без shim и с LD_PRELOAD=shim.so; ns_per_call должен не расти с числом
+// потоков, пока потоков не больше ядер.
+//
+//   identity <mode> [calls на поток]     mode попадает в JSON как есть
+
+#define CALLS_PER_ROUND 6
+
+static long calls;
+static uid_t uid;
+static gid_t gid;
+static char name[256];
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void *worker(void *arg) {
+    long errors = 0;
+    char buf[1024];
+    gid_t groups[256];
+    struct passwd pw, *pwr;
+    struct group gr, *grr;
+    (void)arg;
+
+    for (long i = 0; i < calls; ++i) {
+        errors += getpwuid_r(uid, &pw, buf, sizeof(buf), &pwr) != 0 || !pwr || strcmp(pwr->pw_name, name) != 0;
+        errors += getpwnam_r(name, &pw, buf, sizeof(buf), &pwr) != 0 || !pwr || pwr->pw_uid != uid;
+        errors += getgrgid_r(gid, &gr, buf, sizeof(buf), &grr) != 0 || !grr || grr->gr_gid != gid;
+        errors += getgroups(256, groups) < 0;
+
+        uid_t r, e, s;
+        errors += getresuid(&r, &e, &s) != 0 || e != uid;
+        errors += getuid() != uid;
+    }
+
+    return (void*)errors;
+}
+
+int main(int argc, char *argv[]) {
+    const char * const mode = argc > 1 ? argv[1] : "native";
+    calls = argc > 2 ? atol(argv[2]) : 100000;
+
+    uid = getuid();
+    gid = getgid();
+    const struct passwd * const self = getpwuid(uid);
+    if (!self) return 1;
+    snprintf(name, sizeof(name), "%s", self->pw_name);
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const long max_threads = cpus > 1 ? cpus * 2 : 4;
+
+    for (long threads = 1; threads <= max_threads; threads *= 2) {
+        pthread_t tid[threads];
+        long errors = 0;
+
+        const double start = now_ns();
+        for (long t = 0; t < threads; ++t) pthread_create(&tid[t], NULL, worker, NULL);
+        for (long t = 0; t < threads; ++t) {
+            void *ret;
+            pthread_join(tid[t], &ret);
+            errors += (long)ret;
+        }
+        const double ns = now_ns() - start;
+        const double total = (double)threads * calls * CALLS_PER_ROUND;
+
+        printf("{\"bench\":\"identity\",\"mode\":\"%s\",\"threads\":%ld,\"cpus\":%ld,\"calls\":%.0f,"
+               "\"ns_per_call\":%.1f,\"mcalls_per_s\":%.2f,\"errors\":%ld}\n",
+               mode, threads, cpus, total, ns * threads / total, total / ns * 1e3, errors);
+    }
+
+    return 0;
+}
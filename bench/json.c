@@ -0,0 +1,353 @@
+#define main stfu_main
+#include "../stfu.c"
+#undef main
+
+// Бенчмарк и фаззер потокового JSON токенизатора и percent-кодировщика
+// в сравнении с прежними strstr функциями (скопированы ниже как legacy_*).
+//
+//   bench/json bench            пропускная способность, JSON строки
+//   bench/json fuzz [N]         N случайных мутаций; сборка bench/json-fuzz с ASan/UBSan
+//
+// С -DLIBFUZZER файл становится целью libFuzzer (LLVMFuzzerTestOneInput).
+
+// ---- Прежняя реализация (до потокового токенизатора) ----
+
+// Оптимизированное URL-кодирование (только необходимые символы)
+static char* legacy_url_encode_minimal(const char* const quote) {
+    const size_t len = strlen(quote);
+    char * const encoded = malloc(len * URL_ENCODE_FACTOR + 1);
+    
+    if (__builtin_expect(!encoded, 0)) return NULL;
+    
+    const char *src = quote;
+    char *dst = encoded;
+    
+    while (*src) {
+        switch (*src) {
+            case ' ':
+                *dst++ = '%'; *dst++ = '2'; *dst++ = '0';
+                break;
+            case '"':
+                *dst++ = '%'; *dst++ = '2'; *dst++ = '2';
+                break;
+            default:
+                *dst++ = *src;
+        }
+        ++src;
+    }
+    *dst = '\0';
+    
+    return encoded;
+}
+// Быстрый парсер JSON для API ответов
+static char* legacy_extract_translation(const char* const buffer, const int api_idx) {
+    const char *start, *end;
+    
+    if (api_idx == 0) {
+        // Google API: [[["translated"
+        start = strstr(buffer, "[[[\"");
+        if (!start) return NULL;
+        start += 4;
+        end = strstr(start, "\",");
+    } else {
+        // MyMemory API: "translatedText":"..."
+        start = strstr(buffer, "\"translatedText\":\"");
+        if (!start) return NULL;
+        start += 18;
+        end = strstr(start, "\",");
+    }
+    
+    if (!end || end <= start) return NULL;
+    
+    const size_t len = end - start;
+    char * const result = malloc(len + 1);
+    if (!result) return NULL;
+    
+    memcpy(result, start, len);
+    result[len] = '\0';
+    
+    return result;
+}
+// Оптимизированный парсер JSON для цитат
+static char* legacy_parse_quote_json(const char* const buffer) {
+    const char * const results_start = strstr(buffer, "\"results\":[");
+    if (!results_start) return NULL;
+    
+    // Быстрый поиск случайной цитаты
+    srand(time(NULL) ^ getpid()); // Лучшая энтропия
+    
+    const char *current = results_start + 11;
+    const char *quote_positions[MAX_QUOTES];
+    int quote_count = 0;
+    
+    // Собираем позиции всех цитат
+    while (quote_count < MAX_QUOTES) {
+        const char * const quote_start = strstr(current, "{\"");
+        if (!quote_start) break;
+        quote_positions[quote_count++] = quote_start;
+        current = quote_start + 2;
+    }
+    
+    if (quote_count == 0) return NULL;
+    
+    // Выбираем случайную цитату
+    const char * const selected_quote = quote_positions[rand() % quote_count];
+    
+    const char * const content_start = strstr(selected_quote, "\"content\":\"");
+    const char * const author_start = strstr(selected_quote, "\"author\":\"");
+    
+    if (!content_start || !author_start) return NULL;
+    
+    const char *content_ptr = content_start + 11;
+    const char * const content_end = strstr(content_ptr, "\",");
+    
+    const char *author_ptr = author_start + 10;
+    const char * const author_end = strstr(author_ptr, "\",");
+    
+    if (!content_end || !author_end) return NULL;
+    
+    const size_t content_len = content_end - content_ptr;
+    const size_t author_len = author_end - author_ptr;
+    
+    char * const result = malloc(MAX_QUOTE_SIZE);
+    if (!result) return NULL;
+    
+    snprintf(result, MAX_QUOTE_SIZE, "%.*s|%.*s|Various speeches and writings|Quotable API", 
+             (int)content_len, content_ptr, (int)author_len, author_ptr);
+    
+    return result;
+}
+
+// ---- Общие данные ----
+
+static const char quotes_body_head[] = "{\"count\":10,\"totalCount\":1000,\"page\":1,\"totalPages\":100,\"results\":[";
+static const char google_body[] =
+    "[[[\"\\u041f\\u0440\\u043e\\u0433\\u0440\\u0430\\u043c\\u043c\\u044b \\u0434\\u043e\\u043b\\u0436\\u043d\\u044b\","
+    "\"Programs must\",null,null,10],[\" \\u0447\\u0438\\u0442\\u0430\\u0442\\u044c\\u0441\\u044f \\\"\\u043b\\u044e\\u0434\\u044c\\u043c\\u0438\\\"\","
+    "\"be read by people\",null,null,10]],null,\"en\",null,null,null,1,[],[[\"en\"],null,[1],[\"en\"]]]";
+static const char mymemory_body[] =
+    "{\"responseData\":{\"translatedText\":\"Programme m\\u00fcssen \\\"gelesen\\\" werden & mehr\",\"match\":0.98},"
+    "\"quotaFinished\":false,\"responseDetails\":\"\",\"responseStatus\":200,\"matches\":[{\"id\":\"1\","
+    "\"segment\":\"Programs\",\"translation\":\"Programme\",\"quality\":74}]}";
+
+static char quotes_body[16384];
+
+static void build_quotes_body(void) {
+    int n = snprintf(quotes_body, sizeof(quotes_body), "%s", quotes_body_head);
+    
+    for (int i = 0; i < MAX_QUOTES; ++i) {
+        n += snprintf(quotes_body + n, sizeof(quotes_body) - n,
+                      "%s{\"_id\":\"q%d\",\"content\":\"Programs must be written for people to read, and only "
+                      "incidentally for machines to execute, number %d\",\"author\":\"Harold Abelson\","
+                      "\"tags\":[\"technology\",\"wisdom\"],\"authorSlug\":\"harold-abelson\",\"length\":95,"
+                      "\"dateAdded\":\"2021-05-07\",\"dateModified\":\"2023-04-14\"}",
+                      i ? "," : "", i, i);
+    }
+    
+    snprintf(quotes_body + n, sizeof(quotes_body) - n, "]}");
+}
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Разбор куском заданного размера (chunk == 0 - целиком)
+static int feed_chunked(json_parser_t * const p, const char * const data, const size_t len, const size_t chunk) {
+    int ok = 1;
+    for (size_t off = 0; off < len && ok; off += chunk ? chunk : len) {
+        const size_t n = chunk && len - off > chunk ? chunk : len - off;
+        ok = json_feed(p, data + off, n);
+    }
+    return ok;
+}
+
+static void parse_quotes(const char * const data, const size_t len, const size_t chunk, quote_parse_t * const qp) {
+    json_parser_t p;
+    memset(qp, 0, sizeof(*qp));
+    json_init(&p, on_quote_json, qp);
+    feed_chunked(&p, data, len, chunk);
+}
+
+static void parse_translation(const char * const data, const size_t len, const size_t chunk,
+                              translation_parse_t * const tp) {
+    json_parser_t p;
+    memset(tp, 0, sizeof(*tp));
+    json_init(&p, on_translation_json, tp);
+    feed_chunked(&p, data, len, chunk);
+}
+
+// ---- Пропускная способность ----
+
+static void report(const char * const name, const double ns, const long iterations, const size_t bytes) {
+    printf("{\"bench\":\"%s\",\"iterations\":%ld,\"ns_per_op\":%.1f,\"mb_per_s\":%.1f}\n",
+           name, iterations, ns / iterations, bytes ? bytes * iterations / (ns / 1e9) / 1e6 : 0.0);
+}
+
+#define TIME_LOOP(name, iterations, bytes, body) do { \
+        const double start_ = now_ns(); \
+        for (long i_ = 0; i_ < (iterations); ++i_) { body; } \
+        report(name, now_ns() - start_, iterations, bytes); \
+    } while (0)
+
+static int run_bench(void) {
+    static quote_parse_t qp;
+    static translation_parse_t tp;
+    const size_t quotes_len = strlen(quotes_body);
+    const long n = 20000;
+    
+    TIME_LOOP("quotes_legacy_strstr", n, quotes_len, free(legacy_parse_quote_json(quotes_body)));
+    TIME_LOOP("quotes_stream_whole", n, quotes_len, parse_quotes(quotes_body, quotes_len, 0, &qp));
+    TIME_LOOP("quotes_stream_chunk64", n, quotes_len, parse_quotes(quotes_body, quotes_len, 64, &qp));
+    
+    TIME_LOOP("google_legacy_strstr", n * 10, sizeof(google_body) - 1, free(legacy_extract_translation(google_body, 0)));
+    TIME_LOOP("google_stream", n * 10, sizeof(google_body) - 1,
+              parse_translation(google_body, sizeof(google_body) - 1, 0, &tp));
+    TIME_LOOP("mymemory_legacy_strstr", n * 10, sizeof(mymemory_body) - 1, free(legacy_extract_translation(mymemory_body, 1)));
+    TIME_LOOP("mymemory_stream", n * 10, sizeof(mymemory_body) - 1,
+              parse_translation(mymemory_body, sizeof(mymemory_body) - 1, 0, &tp));
+    
+    static const char text[] = "Any fool can write code that a computer can understand. Good programmers write "
+                               "code that humans can understand & \"maintain\" #1";
+    char encoded[sizeof(text) * URL_ENCODE_FACTOR + 1];
+    TIME_LOOP("urlencode_legacy_minimal", n * 10, sizeof(text) - 1, free(legacy_url_encode_minimal(text)));
+    TIME_LOOP("urlencode_rfc3986_table", n * 10, sizeof(text) - 1, url_encode(encoded, sizeof(encoded), text));
+    
+    return 0;
+}
+
+// ---- Фаззинг ----
+
+// Свойства: токенизатор не выходит за границы (ASan), результат не зависит от
+// разбиения ответа на куски, строки результата всегда завершены '\0'.
+static void check_input(const char * const data, const size_t len, const size_t chunk) {
+    static quote_parse_t whole_q, split_q;
+    static translation_parse_t whole_t, split_t;
+    
+    parse_quotes(data, len, 0, &whole_q);
+    parse_quotes(data, len, chunk, &split_q);
+    if (whole_q.count != split_q.count) abort();
+    for (int i = 0; i < whole_q.count; ++i) {
+        if (strcmp(whole_q.quotes[i], split_q.quotes[i]) != 0) abort();
+        if (!memchr(whole_q.quotes[i], '\0', MAX_QUOTE_SIZE)) abort();
+    }
+    
+    parse_translation(data, len, 0, &whole_t);
+    parse_translation(data, len, chunk, &split_t);
+    if (whole_t.len != split_t.len || whole_t.overflow != split_t.overflow) abort();
+    if (memcmp(whole_t.text, split_t.text, whole_t.len) != 0 || whole_t.text[whole_t.len] != '\0') abort();
+}
+
+// Percent-кодирование: только unreserved и %XX, декодирование возвращает исходник
+static void check_encoder(const char * const data, const size_t len) {
+    char src[256], encoded[256 * URL_ENCODE_FACTOR + 1], decoded[256];
+    const size_t n = len < sizeof(src) - 1 ? len : sizeof(src) - 1;
+    
+    memcpy(src, data, n);
+    src[n] = '\0';
+    
+    const int encoded_len = url_encode(encoded, sizeof(encoded), src);
+    if (encoded_len < 0) abort();
+    
+    size_t out = 0;
+    for (int i = 0; i < encoded_len; ++i) {
+        if (encoded[i] == '%') {
+            unsigned value;
+            if (sscanf(encoded + i + 1, "%2X", &value) != 1) abort();
+            decoded[out++] = value;
+            i += 2;
+        } else if (url_unreserved[(unsigned char)encoded[i]]) {
+            decoded[out++] = encoded[i];
+        } else {
+            abort();
+        }
+    }
+    
+    if (out != strlen(src) || memcmp(decoded, src, out) != 0) abort();
+    
+    // Слишком маленький буфер: ошибка без записи за его пределы
+    char tiny[4];
+    if (strlen(src) * URL_ENCODE_FACTOR >= sizeof(tiny) && url_encode(tiny, sizeof(tiny), src) >= 0 &&
+        strlen(tiny) >= sizeof(tiny)) abort();
+}
+
+#ifdef LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    check_input((const char*)data, size, size > 1 ? 1 + data[0] % 17 : 1);
+    check_encoder((const char*)data, size);
+    return 0;
+}
+#else
+static size_t mutate(char * const buf, size_t len, const size_t cap) {
+    static const char tokens[][8] = {"\\", "\"", "\\u", "\\ud83d", "\\ude00", "{", "}", "[", "]", ",", ":", "\\\"", "\xff"};
+    const int mutations = 1 + rand() % 8;
+    
+    for (int m = 0; m < mutations && len > 0; ++m) {
+        const size_t pos = rand() % len;
+        switch (rand() % 4) {
+            case 0: // Замена байта
+                buf[pos] = rand() % 256;
+                break;
+            case 1: { // Вставка токена
+                const char * const token = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+                const size_t token_len = strlen(token);
+                if (len + token_len >= cap) break;
+                memmove(buf + pos + token_len, buf + pos, len - pos);
+                memcpy(buf + pos, token, token_len);
+                len += token_len;
+                break;
+            }
+            case 2: // Обрезка
+                len = pos;
+                break;
+            default: { // Удаление куска
+                const size_t n = rand() % (len - pos + 1);
+                memmove(buf + pos, buf + pos + n, len - pos - n);
+                len -= n;
+            }
+        }
+    }
+    
+    return len;
+}
+
+static int run_fuzz(const long iterations) {
+    const char * const seeds[] = {quotes_body, google_body, mymemory_body};
+    static char buf[sizeof(quotes_body) * 2];
+    
+    srand(12345);
+    for (long i = 0; i < iterations; ++i) {
+        const char * const seed = seeds[i % 3];
+        size_t len = strlen(seed);
+        memcpy(buf, seed, len);
+        len = mutate(buf, len, sizeof(buf));
+        
+        check_input(buf, len, 1 + rand() % 97);
+        check_encoder(buf, len);
+    }
+    
+    // Исходные ответы должны разбираться полностью и правильно
+    static quote_parse_t qp;
+    static translation_parse_t tp;
+    parse_quotes(quotes_body, strlen(quotes_body), 7, &qp);
+    if (qp.count != MAX_QUOTES) abort();
+    parse_translation(google_body, sizeof(google_body) - 1, 5, &tp);
+    if (strcmp(tp.text, "Программы должны читаться \"людьми\"") != 0) abort();
+    parse_translation(mymemory_body, sizeof(mymemory_body) - 1, 3, &tp);
+    if (strcmp(tp.text, "Programme müssen \"gelesen\" werden & mehr") != 0) abort();
+    
+    printf("{\"fuzz\":\"json\",\"iterations\":%ld,\"result\":\"ok\"}\n", iterations);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    build_quotes_body();
+    
+    if (argc >= 2 && strcmp(argv[1], "fuzz") == 0) return run_fuzz(argc >= 3 ? atol(argv[2]) : 100000);
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) return run_bench();
+    
+    fputs("usage: json bench | json fuzz [iterations]\n", stderr);
+    return 2;
+}
+#endif
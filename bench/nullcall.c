@@ -0,0 +1,10 @@
+#define _GNU_SOURCE
+#include <sys/stat.h>
+#include <fcntl.h>
+
+// Заглушки без системных вызовов для bench/shimcall: LD_PRELOAD="shim.so null.so"
+// направляет RTLD_NEXT из shim сюда, и в замере остаётся только цена самого shim
+
+int access(const char *path, int mode) { (void)path; (void)mode; return 0; }
+int stat(const char *path, struct stat *st) { (void)path; (void)st; return 0; }
+int open(const char *path, int flags, ...) { (void)path; (void)flags; return -1; }
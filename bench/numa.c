@@ -0,0 +1,67 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+// Пропускная способность памяти и доля локальных страниц для цели под
+// --cpus/--numa: чтение буфера, размещённого первым касанием. Доля страниц
+// на узле текущего CPU (move_pages без перемещения) показывает межузловой
+// трафик; на машине с одним узлом она всегда 1.
+//
+//   numa <mode> [mb] [passes]     mode попадает в JSON как есть
+
+static inline double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Узел каждой 64-й страницы буфера
+static double local_fraction(char * const buf, const size_t size, const int node) {
+    const long page = sysconf(_SC_PAGESIZE);
+    const size_t samples = size / page / 64;
+    void **pages = malloc(samples * sizeof(void*));
+    int *status = malloc(samples * sizeof(int));
+    if (!pages || !status || !samples) return -1;
+
+    for (size_t i = 0; i < samples; ++i) pages[i] = buf + i * 64 * page;
+    if (syscall(SYS_move_pages, 0, samples, pages, NULL, status, 0) != 0) return -1;
+
+    size_t local = 0;
+    for (size_t i = 0; i < samples; ++i) local += status[i] == node;
+    free(pages);
+    free(status);
+    return (double)local / samples;
+}
+
+int main(int argc, char *argv[]) {
+    const char * const mode = argc > 1 ? argv[1] : "native";
+    const size_t size = (argc > 2 ? atol(argv[2]) : 512) << 20;
+    const int passes = argc > 3 ? atoi(argv[3]) : 5;
+
+    unsigned long * const buf = malloc(size);
+    if (!buf) return 1;
+    const size_t words = size / sizeof(unsigned long);
+    for (size_t i = 0; i < words; ++i) buf[i] = i;
+
+    volatile unsigned long sink = 0;
+    const double start = now_s();
+    for (int p = 0; p < passes; ++p) {
+        unsigned long sum = 0;
+        for (size_t i = 0; i < words; ++i) sum += buf[i];
+        sink += sum;
+    }
+    const double seconds = now_s() - start;
+
+    unsigned int cpu = 0, node = 0;
+    syscall(SYS_getcpu, &cpu, &node, NULL);
+    printf("{\"bench\":\"numa_read\",\"mode\":\"%s\",\"mb\":%zu,\"cpu\":%u,\"node\":%u,\"gb_per_s\":%.2f,"
+           "\"local_pages\":%.3f}\n",
+           mode, size >> 20, cpu, node, (double)size * passes / seconds / 1e9,
+           local_fraction((char*)buf, size, node));
+    return 0;
+}
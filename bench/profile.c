@@ -0,0 +1,85 @@
+#define main stfu_main
+#include "../stfu.c"
+#undef main
+
+// Поиск профиля приложения в индексе против прежних двух strstr("firefox"):
+// ns на поиск для 4 встроенных и 100 сгенерированных профилей, попадание и
+// промах, плюс цена открытия индекса (open + mmap + проверка) на запуск.
+//
+//   bench/profile [iterations] [index]     index по умолчанию profiles.idx
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile uintptr_t sink;
+
+static void report(const char * const name, const int count, const double ns, const long iterations) {
+    printf("{\"bench\":\"%s\",\"profiles\":%d,\"iterations\":%ld,\"ns_per_lookup\":%.1f}\n",
+           name, count, iterations, ns / iterations);
+}
+
+#define TIME_LOOKUPS(name, count, iterations, expr) do { \
+        const double start_ = now_ns(); \
+        for (long i_ = 0; i_ < (iterations); ++i_) sink += (uintptr_t)(expr); \
+        report(name, count, now_ns() - start_, iterations); \
+    } while (0)
+
+// Прежняя проверка: build_target_argv и main вызывали её по разу
+static inline int legacy_is_firefox(const char * const cmd) {
+    return strstr(cmd, "firefox") != NULL;
+}
+
+static void lookups(const int count, const long n) {
+    TIME_LOOKUPS("profile_hit_path", count, n, profile_find("/usr/bin/firefox"));
+    TIME_LOOKUPS("profile_hit_name", count, n, profile_find("code"));
+    TIME_LOOKUPS("profile_miss", count, n, profile_find("/usr/lib/jvm/java-17-openjdk/bin/java"));
+}
+
+int main(int argc, char *argv[]) {
+    const long n = argc > 1 ? atol(argv[1]) : 2000000;
+    const char * const index = argc > 2 ? argv[2] : "profiles.idx";
+
+    TIME_LOOKUPS("legacy_strstr_hit", 0, n,
+                 legacy_is_firefox("/usr/bin/firefox") + legacy_is_firefox("/usr/bin/firefox"));
+    TIME_LOOKUPS("legacy_strstr_miss", 0, n,
+                 legacy_is_firefox("/usr/lib/jvm/java-17-openjdk/bin/java") +
+                 legacy_is_firefox("/usr/lib/jvm/java-17-openjdk/bin/java"));
+
+    // Открытие индекса: один раз на запуск stfu
+    const long opens = n / 100 + 1;
+    const double start = now_ns();
+    for (long i = 0; i < opens; ++i) {
+        if (!profiles_map(index)) {
+            fprintf(stderr, "bench/profile: cannot map %s\n", index);
+            return 1;
+        }
+        munmap((void*)profiles, profiles->size);
+    }
+    report("profiles_open", 0, now_ns() - start, opens);
+
+    profiles_map(index);
+    lookups(profiles->count, n);
+
+    // 100 профилей по 3 имени поверх встроенных
+    const size_t builtin = profiles_conf_end - profiles_conf;
+    char * const text = malloc(builtin + 100 * 128);
+    if (!text) return 1;
+
+    size_t len = builtin;
+    memcpy(text, profiles_conf, builtin);
+    for (int i = 0; i < 100; ++i) {
+        len += sprintf(text + len, "\n[app%d]\nmatch = app%d app%d-bin /opt/app%d/app%d\narg = --flag%d\n",
+                       i, i, i, i, i, i);
+    }
+    text[len] = '\0';
+
+    size_t size;
+    profiles = (const profiles_header_t*)profiles_compile(text, "generated", &size);
+    if (!profiles) return 1;
+    lookups(profiles->count, n);
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+// Системные вызовы в обход libc, как у статических и Go программ: ns на вызов
+// для вызовов личности (их под --seccomp отвечает супервизор stfu) и для
+// остальных (должны остаться на быстром пути ядра). Собирается статически.
+//
+//   rawcall <mode> [iterations]     mode попадает в JSON как есть
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char * const name, const char * const mode, const double ns, const long iterations,
+                   const long value) {
+    printf("{\"bench\":\"%s\",\"mode\":\"%s\",\"iterations\":%ld,\"ns_per_call\":%.1f,\"value\":%ld}\n",
+           name, mode, iterations, ns / iterations, value);
+}
+
+#define TIME_CALLS(name, mode, iterations, call) do { \
+        long value_ = 0; \
+        for (long i_ = 0; i_ < (iterations) / 10; ++i_) { value_ = (call); } \
+        const double start_ = now_ns(); \
+        for (long i_ = 0; i_ < (iterations); ++i_) { value_ = (call); } \
+        report(name, mode, now_ns() - start_, iterations, value_); \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    const char * const mode = argc > 1 ? argv[1] : "native";
+    const long n = argc > 2 ? atol(argv[2]) : 100000;
+    unsigned int r, e, s;
+
+    // Перехватываемые вызовы
+    TIME_CALLS("getuid", mode, n, syscall(SYS_getuid));
+    TIME_CALLS("getegid", mode, n, syscall(SYS_getegid));
+    TIME_CALLS("getresuid", mode, n, (syscall(SYS_getresuid, &r, &e, &s), (long)e));
+
+    // Остальные: только проход фильтра в ядре
+    TIME_CALLS("getppid", mode, n * 10, syscall(SYS_getppid));
+    TIME_CALLS("openat_close", mode, n, ({
+        const long fd_ = syscall(SYS_openat, AT_FDCWD, "/", O_RDONLY | O_DIRECTORY);
+        syscall(SYS_close, fd_);
+        fd_;
+    }));
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// Цена вызова через shim: ns на вызов без правил, с почти совпавшим префиксом,
+// с запретом и с перенаправлением. Запускается дважды, с LD_PRELOAD=null.so и
+// с LD_PRELOAD="shim.so null.so": заглушки убирают шум системных вызовов,
+// разница - накладные расходы shim.
+//
+//   shimcall <mode> [iterations]     mode попадает в JSON как есть
+
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char * const name, const char * const mode, const double ns, const long iterations) {
+    printf("{\"bench\":\"%s\",\"mode\":\"%s\",\"iterations\":%ld,\"ns_per_call\":%.1f}\n",
+           name, mode, iterations, ns / iterations);
+}
+
+#define TIME_CALLS(name, mode, iterations, call) do { \
+        for (long i_ = 0; i_ < (iterations) / 10; ++i_) { call; } \
+        const double start_ = now_ns(); \
+        for (long i_ = 0; i_ < (iterations); ++i_) { call; } \
+        report(name, mode, now_ns() - start_, iterations); \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    const char * const mode = argc > 1 ? argv[1] : "native";
+    const long n = argc > 2 ? atol(argv[2]) : 1000000;
+    struct stat st;
+
+    // Пути без правил: первый байт не совпадает ни с одним префиксом
+    TIME_CALLS("access_pass", mode, n, access("/usr/lib", F_OK));
+    TIME_CALLS("stat_pass", mode, n, stat("/usr/lib", &st));
+    TIME_CALLS("open_pass", mode, n, {
+        const int fd = open("/usr/lib", O_RDONLY | O_DIRECTORY);
+        if (fd >= 0) close(fd);
+    });
+    TIME_CALLS("access_relative", mode, n, access("bench", F_OK));
+
+    // Общий с правилом префикс /snap/...: проход по дереву без совпадения
+    TIME_CALLS("access_near_miss", mode, n, access("/snap/core20/current", F_OK));
+
+    // Совпадение: запрет без системного вызова и перенаправление
+    TIME_CALLS("access_deny", mode, n, access("/snap/firefox/current", F_OK));
+    TIME_CALLS("stat_redirect", mode, n, stat("/stfu-bench/lib", &st));
+
+    return 0;
+}
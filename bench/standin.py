@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Локальный stand-in для API цитат и перевода (бенчмарк --help без интернета).
+#
+#   standin.py PORT [DELAY_MS]
+#
+# /quotes -> ответ в формате quotable.io, /translate_a/single -> Google,
+# /get -> MyMemory. DELAY_MS задерживает каждый ответ (медленный backend).
+
+import json
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse, parse_qs
+
+DELAY = int(sys.argv[2]) / 1000 if len(sys.argv) > 2 else 0
+
+QUOTES = {"count": 10, "results": [
+    {"_id": str(i), "content": "Stand-in quote number %d, with \"escaped\" text & symbols" % i,
+     "author": "Stand-in Author %d" % i, "tags": ["technology"], "length": 60}
+    for i in range(10)]}
+
+
+class Handler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        time.sleep(DELAY)
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+
+        if url.path == "/quotes":
+            body = QUOTES
+        elif url.path == "/translate_a/single":
+            text = "[%s] %s" % (query["tl"][0], query["q"][0])
+            body = [[[text, query["q"][0], None, None, 10]], None, "en"]
+        elif url.path == "/get":
+            text = "[%s] %s" % (query["langpair"][0], query["q"][0])
+            body = {"responseData": {"translatedText": text, "match": 1}, "responseStatus": 200}
+        else:
+            self.send_error(404)
+            return
+
+        data = json.dumps(body, separators=(",", ":")).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, *args):
+        pass
+
+
+class Server(ThreadingHTTPServer):
+    # Проигравшие в гонке запросы stfu отменяет: обрыв соединения здесь норма
+    def handle_error(self, request, client_address):
+        pass
+
+
+Server(("127.0.0.1", int(sys.argv[1])), Handler).serve_forever()
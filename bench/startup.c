@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sched.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// Драйвер бенчмарка запуска: N раз fork+exec команды, статистика в JSON
+//
+// startup [-n runs] [-w warmup] [-u uid] [-o] [-p prep] [-d per] [-r] -N name -- cmd [args...]
+//   -u uid   сбросить права до uid перед exec (для SUID и -s сценариев)
+//   -o       запуск в пустом сетевом namespace (офлайн режим)
+//   -p prep  shell команда перед каждым прогоном (вне замера), напр. очистка кэша
+//   -d per   время прогона делится на per (цена одной задачи в --batch)
+//   -r       время до первого байта цели в stdout (задержка до exec), а не до выхода
+
+static inline double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int ready_mode = 0;
+
+// Один прогон: время от fork до завершения цели (или до её первого байта
+// в режиме -r), -1 при ошибке
+static double run_once(char * const argv[], const int uid, const int offline) {
+    int out[2] = {-1, -1};
+    if (ready_mode && pipe(out) != 0) return -1;
+    
+    const double start = now_us();
+    const pid_t pid = fork();
+    
+    if (pid == 0) {
+        const int null_fd = open("/dev/null", O_RDWR);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(ready_mode ? out[1] : null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (ready_mode) {
+            close(out[0]);
+            close(out[1]);
+        }
+        
+        if (offline && unshare(CLONE_NEWNET) != 0) _exit(126);
+        if (uid >= 0 && (setgid(uid) != 0 || setuid(uid) != 0)) _exit(126);
+        
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    
+    double elapsed = -1;
+    if (ready_mode) {
+        char buf[256];
+        close(out[1]);
+        if (read(out[0], buf, sizeof(buf)) > 0) elapsed = now_us() - start;
+        while (read(out[0], buf, sizeof(buf)) > 0) {}
+        close(out[0]);
+    }
+    if (pid < 0) return -1;
+    
+    int status;
+    if (waitpid(pid, &status, 0) != pid) return -1;
+    
+    if (!ready_mode) elapsed = now_us() - start;
+    else if (elapsed < 0) return -1;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? elapsed : -1;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 200, warmup = 5, uid = -1, offline = 0, per = 1, opt;
+    const char *name = "unnamed", *prep = NULL;
+    
+    while ((opt = getopt(argc, argv, "+n:w:u:op:d:rN:")) != -1) {
+        switch (opt) {
+            case 'n': runs = atoi(optarg); break;
+            case 'w': warmup = atoi(optarg); break;
+            case 'u': uid = atoi(optarg); break;
+            case 'o': offline = 1; break;
+            case 'p': prep = optarg; break;
+            case 'd': per = atoi(optarg); break;
+            case 'r': ready_mode = 1; break;
+            case 'N': name = optarg; break;
+            default: return 2;
+        }
+    }
+    
+    if (optind >= argc || runs <= 0 || per <= 0) {
+        fputs("usage: startup [-n runs] [-w warmup] [-u uid] [-o] [-p prep] [-d per] [-r] -N name -- cmd [args...]\n", stderr);
+        return 2;
+    }
+    
+    char * const * const cmd = &argv[optind];
+    double * const samples = malloc(runs * sizeof(double));
+    if (!samples) return 1;
+    
+    for (int i = 0; i < warmup; ++i) {
+        if (prep && system(prep)) {}
+        run_once(cmd, uid, offline);
+    }
+    
+    int failures = 0;
+    for (int i = 0; i < runs; ++i) {
+        if (prep && system(prep)) {}
+        samples[i] = run_once(cmd, uid, offline);
+        if (samples[i] < 0) ++failures;
+        else samples[i] /= per;
+    }
+    
+    if (failures) {
+        printf("{\"bench\":\"%s\",\"runs\":%d,\"failures\":%d}\n", name, runs, failures);
+        free(samples);
+        return 1;
+    }
+    
+    qsort(samples, runs, sizeof(double), cmp_double);
+    
+    double sum = 0, sq = 0;
+    for (int i = 0; i < runs; ++i) sum += samples[i];
+    const double mean = sum / runs;
+    for (int i = 0; i < runs; ++i) sq += (samples[i] - mean) * (samples[i] - mean);
+    
+    const int p99 = (int)ceil(runs * 0.99) - 1;
+    
+    printf("{\"bench\":\"%s\",\"runs\":%d,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+           "\"stddev_us\":%.1f,\"min_us\":%.1f,\"max_us\":%.1f}\n",
+           name, runs, mean, samples[runs / 2], samples[p99 > 0 ? p99 : 0],
+           sqrt(sq / runs), samples[0], samples[runs - 1]);
+    
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef STFU_CORPUS_H
+#define STFU_CORPUS_H
+
+#include <stdint.h>
+
+// Бинарный корпус цитат (генерируется mkcorpus, stfu читает через mmap):
+//   заголовок | индекс uint32_t[count][columns] | пул строк с '\0'
+// Колонки: цитата, автор, контекст, источник, затем перевод цитаты на
+// каждый язык из langs. Смещения считаются от начала файла, 0 - нет строки.
+#define CORPUS_MAGIC "STFUQC1"
+#define CORPUS_FIELDS 4
+#define CORPUS_MAX_LANGS 16
+
+typedef struct {
+    char magic[8];
+    uint32_t count;
+    uint32_t columns;
+    uint32_t size;
+    uint32_t reserved;
+    char langs[CORPUS_MAX_LANGS][4];
+} corpus_header_t;
+
+#endif
@@ -0,0 +1,112 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "corpus.h"
+
+// Генератор бинарного корпуса цитат из TSV:
+//   первая строка: quote author context source <язык>...
+//   далее по строке на цитату, пустая колонка перевода допустима
+
+#define MAX_COLUMNS (CORPUS_FIELDS + CORPUS_MAX_LANGS)
+
+static void __attribute__((noreturn)) die(const char * const msg, const char * const arg) {
+    fprintf(stderr, "mkcorpus: %s%s\n", msg, arg ?: "");
+    exit(1);
+}
+
+// Разбиение строки по табуляции на месте
+static int split(char *line, char *fields[]) {
+    int n = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    
+    while (line && n < MAX_COLUMNS) fields[n++] = strsep(&line, "\t");
+    return line ? -1 : n;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) die("usage: mkcorpus <quotes.tsv> <out.corpus>", NULL);
+    
+    FILE * const in = fopen(argv[1], "r");
+    if (!in) die("cannot open ", argv[1]);
+    
+    corpus_header_t header = {0};
+    memcpy(header.magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+    
+    uint32_t *index = NULL;
+    char *pool = NULL;
+    size_t pool_len = 0, pool_cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    
+    while (getline(&line, &line_cap, in) > 0) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        char *fields[MAX_COLUMNS];
+        const int n = split(line, fields);
+        if (n < CORPUS_FIELDS) die("too few or too many columns: ", fields[0]);
+        
+        // Заголовок задаёт языки колонок перевода
+        if (header.columns == 0) {
+            header.columns = n;
+            for (int i = CORPUS_FIELDS; i < n; ++i)
+                snprintf(header.langs[i - CORPUS_FIELDS], sizeof(header.langs[0]), "%s", fields[i]);
+            continue;
+        }
+        
+        if ((uint32_t)n > header.columns) die("extra columns in: ", fields[0]);
+        
+        index = realloc(index, (header.count + 1) * header.columns * sizeof(uint32_t));
+        if (!index) die("out of memory", NULL);
+        
+        for (uint32_t col = 0; col < header.columns; ++col) {
+            const char * const value = (int)col < n ? fields[col] : "";
+            const size_t len = strlen(value);
+            
+            if (len == 0) {
+                if (col < CORPUS_FIELDS) die("empty required field in: ", fields[0]);
+                index[header.count * header.columns + col] = 0;
+                continue;
+            }
+            
+            if (pool_len + len + 1 > pool_cap) {
+                pool_cap = (pool_cap + len + 1) * 2;
+                pool = realloc(pool, pool_cap);
+                if (!pool) die("out of memory", NULL);
+            }
+            
+            // Смещения относительно начала файла, пул идёт после индекса
+            index[header.count * header.columns + col] = pool_len;
+            memcpy(pool + pool_len, value, len + 1);
+            pool_len += len + 1;
+        }
+        
+        ++header.count;
+    }
+    
+    free(line);
+    fclose(in);
+    
+    if (header.count == 0) die("no quotes in ", argv[1]);
+    
+    const size_t pool_start = sizeof(header) + (size_t)header.count * header.columns * sizeof(uint32_t);
+    if (pool_start + pool_len > UINT32_MAX) die("corpus too large", NULL);
+    header.size = pool_start + pool_len;
+    
+    for (size_t i = 0; i < (size_t)header.count * header.columns; ++i)
+        if (index[i] || i % header.columns < CORPUS_FIELDS) index[i] += pool_start;
+    
+    FILE * const out = fopen(argv[2], "wb");
+    if (!out) die("cannot create ", argv[2]);
+    
+    if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(index, sizeof(uint32_t), (size_t)header.count * header.columns, out) != (size_t)header.count * header.columns ||
+        fwrite(pool, 1, pool_len, out) != pool_len ||
+        fclose(out) != 0) {
+        die("write failed: ", argv[2]);
+    }
+    
+    free(index);
+    free(pool);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef STFU_PROFILES_H
+#define STFU_PROFILES_H
+
+#include <stdint.h>
+
+// Бинарный индекс профилей приложений (stfu --compile-profiles, stfu читает через mmap):
+//   заголовок | хеш-таблица profile_slot_t[slots] | profile_t[count] | списки и строки
+// Ключ - базовое имя или полный путь программы, таблица с открытой адресацией
+// (slots - степень двойки, заполнена не больше чем наполовину). Список -
+// uint32_t число строк, затем их смещения. Смещения считаются от начала
+// файла, 0 - нет значения.
+#define PROFILES_MAGIC "STFUPF2"
+#define PROFILES_MAX_ENV 32         // Переменных env в одном профиле
+
+enum { PROFILE_ARGS, PROFILE_ENV, PROFILE_HOME, PROFILE_RULES, PROFILE_PLACE, PROFILE_LISTS };
+
+typedef struct {
+    char magic[8];
+    uint32_t size;
+    uint32_t slots;
+    uint32_t count;
+    uint32_t defaults;              // Номер профиля [default] + 1, 0 - нет
+} profiles_header_t;
+
+typedef struct {
+    uint32_t hash;                  // FNV-1a ключа, младшие 32 бита
+    uint32_t key;
+    uint32_t profile;               // Номер профиля + 1, 0 - пустой слот
+} profile_slot_t;
+
+typedef struct {
+    uint32_t name;
+    uint32_t lists[PROFILE_LISTS];
+} profile_t;
+
+#endif
@@ -0,0 +1,1007 @@
+// Библиотека подмены для LD_PRELOAD. Исходник встраивается в stfu при сборке,
+// компилируется на целевой машине при первом запуске и кэшируется по хешу.
+//
+// Правила путей (STFU_RULES, разделитель ';' или перевод строки):
+//   deny:/prefix             путь не существует (ENOENT)
+//   redirect:/prefix=/target /prefix/x -> /target/x (без =target - в STFU_CUSTOM_HOME)
+//   pass:/prefix             без изменений (исключение внутри deny/redirect)
+// Префикс совпадает по границе компонента, побеждает самый длинный; при
+// одинаковом префиксе - правило, заданное позже. Относительные пути не меняются.
+//
+// Личность (STFU_IDENTITY=имя:uid:gid:home:shell:gid,gid,...): подменяет
+// пользователя процесса и его записи passwd/group; без переменной - user 1000.
+//
+// Статистика (STFU_STATS=<сессия>): счётчики вызовов и гистограммы времени
+// каждого перехватчика в общем сегменте /dev/shm, формат - stfu_stats.h.
+//
+// Область (STFU_SCOPE от stfu --preload-scope): каким потомкам exec* и
+// posix_spawn оставляют shim в LD_PRELOAD.
+//
+// Трассировка (STFU_TRACE_FD=<fd> от stfu --trace): время конструктора в
+// файле трассировки stfu; дескриптор закрывается до main() цели.
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <spawn.h>
+#ifndef STFU_STATS_H
+#include "stfu_stats.h" // При сборке stfu заголовок уже встроен перед этим файлом
+#endif
+
+// Перехватываемые символы: порядок задаёт номер счётчика в сегменте
+#define STATS_SYMBOLS(X) \
+    X(getuid) X(geteuid) X(getgid) X(getegid) X(getresuid) X(getresgid) X(getgroups) \
+    X(getlogin) X(getlogin_r) X(getpwuid) X(getpwuid_r) X(getpwnam) X(getpwnam_r) \
+    X(getgrgid) X(getgrgid_r) X(getgrnam) X(getgrnam_r) \
+    X(access) X(faccessat) X(stat) X(lstat) X(fstatat) X(stat64) X(lstat64) X(fstatat64) X(statx) \
+    X(__xstat) X(__lxstat) X(__fxstatat) \
+    X(open) X(open64) X(openat) X(openat64) X(__open_2) X(__open64_2) X(__openat_2) X(__openat64_2) \
+    X(fopen) X(fopen64) X(opendir) \
+    X(execve) X(execv) X(execvp) X(execvpe) X(execl) X(execlp) X(execle) X(posix_spawn) X(posix_spawnp)
+
+#define STATS_ENUM(name) SYM_##name,
+enum { STATS_SYMBOLS(STATS_ENUM) SYM_COUNT };
+
+static stats_segment_t *stats;
+
+// Вызовы копятся в потоке и сбрасываются в сегмент вместе с замером времени,
+// поэтому общая кэш-линия трогается раз в STATS_SAMPLE вызовов
+static __thread unsigned int stats_pending[SYM_COUNT] __attribute__((tls_model("initial-exec")));
+
+static inline long long stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline long long stats_enter(const int sym) {
+    if (!stats || ++stats_pending[sym] < STATS_SAMPLE) return 0;
+    
+    __atomic_fetch_add(&stats->symbol[sym].calls, stats_pending[sym], __ATOMIC_RELAXED);
+    stats_pending[sym] = 0;
+    return stats_now();
+}
+
+static inline void stats_leave(const int sym, const long long start) {
+    if (!start) return;
+    
+    const unsigned long long ns = stats_now() - start;
+    const int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    stats_symbol_t * const s = &stats->symbol[sym];
+    
+    __atomic_fetch_add(&s->sampled, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->hist[bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1], 1, __ATOMIC_RELAXED);
+}
+
+// Остаток счётчиков основного потока при обычном завершении
+__attribute__((destructor)) static void stats_flush(void) {
+    if (!stats) return;
+    for (int i = 0; i < SYM_COUNT; ++i) {
+        if (stats_pending[i]) __atomic_fetch_add(&stats->symbol[i].calls, stats_pending[i], __ATOMIC_RELAXED);
+        stats_pending[i] = 0;
+    }
+}
+
+enum { RULE_DENY, RULE_REDIRECT, RULE_PASS };
+
+typedef struct {
+    int kind;
+    size_t prefix_len;
+    const char *target;
+    size_t target_len;
+} rule_t;
+
+// Префиксное дерево по байтам: потомки узла - список через sibling
+typedef struct {
+    int child;
+    int sibling;
+    int rule;       // -1 - префикс не заканчивается в этом узле
+    unsigned char c;
+} trie_node_t;
+
+static rule_t *rules;
+static trie_node_t *trie;
+static int trie_size;
+
+// Быстрый отказ: второй байт пути (после '/') не начинает ни одного правила
+static unsigned char first_byte[256];
+
+// Все настоящие функции разрешаются один раз в конструкторе
+static int (*real_access)(const char*, int);
+static int (*real_faccessat)(int, const char*, int, int);
+static int (*real_stat)(const char*, struct stat*);
+static int (*real_lstat)(const char*, struct stat*);
+static int (*real_fstatat)(int, const char*, struct stat*, int);
+static int (*real_stat64)(const char*, struct stat64*);
+static int (*real_lstat64)(const char*, struct stat64*);
+static int (*real_fstatat64)(int, const char*, struct stat64*, int);
+static int (*real_statx)(int, const char*, int, unsigned int, struct statx*);
+static int (*real___xstat)(int, const char*, struct stat*);
+static int (*real___lxstat)(int, const char*, struct stat*);
+static int (*real___fxstatat)(int, int, const char*, struct stat*, int);
+static int (*real_open)(const char*, int, ...);
+static int (*real_open64)(const char*, int, ...);
+static int (*real_openat)(int, const char*, int, ...);
+static int (*real_openat64)(int, const char*, int, ...);
+static int (*real___open_2)(const char*, int);
+static int (*real___open64_2)(const char*, int);
+static int (*real___openat_2)(int, const char*, int);
+static int (*real___openat64_2)(int, const char*, int);
+static FILE *(*real_fopen)(const char*, const char*);
+static FILE *(*real_fopen64)(const char*, const char*);
+static DIR *(*real_opendir)(const char*);
+static struct passwd *(*real_getpwuid)(uid_t);
+static int (*real_getpwuid_r)(uid_t, struct passwd*, char*, size_t, struct passwd**);
+static struct passwd *(*real_getpwnam)(const char*);
+static int (*real_getpwnam_r)(const char*, struct passwd*, char*, size_t, struct passwd**);
+static struct group *(*real_getgrgid)(gid_t);
+static int (*real_getgrgid_r)(gid_t, struct group*, char*, size_t, struct group**);
+static struct group *(*real_getgrnam)(const char*);
+static int (*real_getgrnam_r)(const char*, struct group*, char*, size_t, struct group**);
+static int (*real_execve)(const char*, char* const[], char* const[]);
+static int (*real_execvpe)(const char*, char* const[], char* const[]);
+static int (*real_posix_spawn)(pid_t*, const char*, const posix_spawn_file_actions_t*, const posix_spawnattr_t*,
+                               char* const[], char* const[]);
+static int (*real_posix_spawnp)(pid_t*, const char*, const posix_spawn_file_actions_t*, const posix_spawnattr_t*,
+                                char* const[], char* const[]);
+
+#define IDENTITY_GROUPS 64
+
+// Поддельная личность: заполняется один раз в конструкторе и дальше только
+// читается, поэтому все перехватчики обходятся без блокировок и кучи
+static struct {
+    uid_t uid, real_uid;
+    gid_t gid, real_gid;
+    int ngroups;
+    gid_t groups[IDENTITY_GROUPS];
+    char name[64];
+    char home[PATH_MAX];
+    char shell[PATH_MAX];
+    struct passwd pw;
+    struct group gr;
+    char *no_members[1];
+} identity;
+
+static int trie_child(const int node, const unsigned char c) {
+    int child = trie[node].child;
+    while (child && trie[child].c != c) child = trie[child].sibling;
+    return child;
+}
+
+static void trie_insert(const char * const prefix, const size_t len, const int rule) {
+    int node = 0;
+    
+    for (size_t i = 0; i < len; ++i) {
+        const unsigned char c = prefix[i];
+        int child = trie_child(node, c);
+        
+        if (!child) {
+            child = trie_size++;
+            trie[child] = (trie_node_t){0, trie[node].child, -1, c};
+            trie[node].child = child;
+        }
+        node = child;
+    }
+    
+    trie[node].rule = rule;
+}
+
+// Разбор правил на месте; возвращает число правил
+static int compile_rules(char * const text, const char * const custom_home) {
+    int count = 0;
+    
+    for (char *save = NULL, *item = strtok_r(text, ";\n", &save); item; item = strtok_r(NULL, ";\n", &save)) {
+        char * const colon = strchr(item, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        
+        rule_t rule = {-1, 0, NULL, 0};
+        if (strcmp(item, "deny") == 0) rule.kind = RULE_DENY;
+        else if (strcmp(item, "redirect") == 0) rule.kind = RULE_REDIRECT;
+        else if (strcmp(item, "pass") == 0) rule.kind = RULE_PASS;
+        
+        char * const prefix = colon + 1;
+        if (rule.kind == RULE_REDIRECT) {
+            char * const eq = strchr(prefix, '=');
+            if (eq) *eq = '\0';
+            rule.target = eq && eq[1] ? eq + 1 : custom_home;
+            if (!rule.target || rule.target[0] != '/') continue;
+            rule.target_len = strlen(rule.target);
+            while (rule.target_len > 1 && rule.target[rule.target_len - 1] == '/') --rule.target_len;
+        }
+        
+        if (rule.kind < 0 || prefix[0] != '/') continue;
+        
+        // Завершающие '/' не нужны: граница компонента проверяется при поиске
+        rule.prefix_len = strlen(prefix);
+        while (rule.prefix_len > 1 && prefix[rule.prefix_len - 1] == '/') --rule.prefix_len;
+        
+        if (rule.prefix_len == 1) memset(first_byte, 1, sizeof(first_byte));
+        else first_byte[(unsigned char)prefix[1]] = 1;
+        
+        rules[count] = rule;
+        trie_insert(prefix, rule.prefix_len, count++);
+    }
+    
+    return count;
+}
+
+// Поле до ':' (или до конца строки) в dst; NULL, если не помещается или пусто
+static const char* identity_field(const char *p, char * const dst, const size_t size) {
+    const char * const end = strchrnul(p, ':');
+    const size_t len = end - p;
+    if (!len || len >= size) return NULL;
+    
+    memcpy(dst, p, len);
+    dst[len] = '\0';
+    return *end ? end + 1 : end;
+}
+
+static const char* identity_number(const char *p, unsigned int * const value, const char stop) {
+    char *end;
+    const unsigned long n = strtoul(p, &end, 10);
+    if (end == p || (*end != stop && *end) || n > 0xfffffffeUL) return NULL;
+    
+    *value = n;
+    return *end ? end + 1 : end;
+}
+
+// Разбор STFU_IDENTITY; при любой ошибке остаётся личность по умолчанию
+static void identity_load(void) {
+    identity.real_uid = syscall(SYS_getuid);
+    identity.real_gid = syscall(SYS_getgid);
+    identity.uid = identity.gid = 1000;
+    identity.ngroups = 1;
+    identity.groups[0] = 1000;
+    strcpy(identity.name, "user");
+    strcpy(identity.shell, "/bin/bash");
+    
+    const char * const home = getenv("STFU_CUSTOM_HOME");
+    snprintf(identity.home, sizeof(identity.home), "%s", home && *home ? home : "/home/user");
+    
+    const char *p = getenv("STFU_IDENTITY");
+    char name[sizeof(identity.name)], home_dir[sizeof(identity.home)], shell[sizeof(identity.shell)];
+    unsigned int uid, gid, group;
+    gid_t groups[IDENTITY_GROUPS];
+    int ngroups = 0;
+    
+    if (p && (p = identity_field(p, name, sizeof(name))) && (p = identity_number(p, &uid, ':')) &&
+        (p = identity_number(p, &gid, ':')) && (p = identity_field(p, home_dir, sizeof(home_dir))) &&
+        (p = identity_field(p, shell, sizeof(shell)))) {
+        while (*p && ngroups < IDENTITY_GROUPS && (p = identity_number(p, &group, ','))) groups[ngroups++] = group;
+        
+        if (p && !*p) {
+            identity.uid = uid;
+            identity.gid = gid;
+            identity.ngroups = ngroups;
+            memcpy(identity.groups, groups, ngroups * sizeof(gid_t));
+            strcpy(identity.name, name);
+            strcpy(identity.home, home_dir);
+            strcpy(identity.shell, shell);
+        }
+    }
+    
+    identity.pw = (struct passwd){identity.name, "x", identity.uid, identity.gid,
+                                  identity.name, identity.home, identity.shell};
+    identity.gr = (struct group){identity.name, "x", identity.gid, identity.no_members};
+}
+
+static inline int identity_user(const uid_t uid) {
+    return uid == identity.uid || uid == identity.real_uid;
+}
+
+static inline int identity_group(const gid_t gid) {
+    return gid == identity.gid || gid == identity.real_gid;
+}
+
+// Копия строки в буфер вызывающего; NULL, если место кончилось
+static char* identity_put(char ** const p, const char * const end, const char * const s) {
+    const size_t len = strlen(s) + 1;
+    if ((size_t)(end - *p) < len) return NULL;
+    
+    char * const dst = memcpy(*p, s, len);
+    *p += len;
+    return dst;
+}
+
+// Реентерабельные варианты: всё в buf, ERANGE при нехватке места
+static int identity_passwd_r(struct passwd * const pwd, char * const buf, const size_t buflen,
+                             struct passwd ** const result) {
+    char *p = buf;
+    const char * const end = buf + buflen;
+    
+    *result = NULL;
+    if (!(pwd->pw_name = identity_put(&p, end, identity.name)) ||
+        !(pwd->pw_passwd = identity_put(&p, end, "x")) ||
+        !(pwd->pw_dir = identity_put(&p, end, identity.home)) ||
+        !(pwd->pw_shell = identity_put(&p, end, identity.shell))) return ERANGE;
+    
+    pwd->pw_gecos = pwd->pw_name;
+    pwd->pw_uid = identity.uid;
+    pwd->pw_gid = identity.gid;
+    *result = pwd;
+    return 0;
+}
+
+static int identity_group_r(struct group * const grp, char * const buf, const size_t buflen,
+                            struct group ** const result) {
+    // Пустой список членов группы - один выровненный NULL в начале буфера
+    const size_t skip = -(uintptr_t)buf % sizeof(char*);
+    char *p = buf + skip + sizeof(char*);
+    const char * const end = buf + buflen;
+    
+    *result = NULL;
+    if (buflen < skip + sizeof(char*) ||
+        !(grp->gr_name = identity_put(&p, end, identity.name)) ||
+        !(grp->gr_passwd = identity_put(&p, end, "x"))) return ERANGE;
+    
+    grp->gr_mem = (char**)(buf + skip);
+    grp->gr_mem[0] = NULL;
+    grp->gr_gid = identity.gid;
+    *result = grp;
+    return 0;
+}
+
+// Подключение к сегменту сессии: первый процесс дерева создаёт его, остальные
+// (в том числе после exec) дописывают в тот же
+static void stats_attach(void) {
+    const char * const session = getenv("STFU_STATS");
+    if (!session || !*session || strchr(session, '/')) return;
+    
+    // shm_open не проходит через open(): сегмент не зависит от других preload
+    // библиотек и от собственных правил shim
+    char name[128];
+    if (snprintf(name, sizeof(name), "/" STATS_PREFIX "%s", session) >= (int)sizeof(name)) return;
+    
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+    
+    // Усечение до того же размера у уже созданного сегмента ничего не меняет
+    void * const segment = ftruncate(fd, sizeof(stats_segment_t)) == 0 ?
+        mmap(NULL, sizeof(stats_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    
+    if (segment == MAP_FAILED) return;
+    stats = segment;
+    
+    // Одинаковые значения от разных процессов: гонка записи безвредна
+    if (__atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC) {
+        static const char names[][STATS_NAME_MAX] = {
+#define STATS_NAME(name) #name,
+            STATS_SYMBOLS(STATS_NAME)
+        };
+        
+        for (int i = 0; i < SYM_COUNT; ++i) memcpy(stats->symbol[i].name, names[i], STATS_NAME_MAX);
+        stats->version = STATS_VERSION;
+        stats->symbols = SYM_COUNT;
+        stats->sample = STATS_SAMPLE;
+        stats->created = time(NULL);
+        stats->root_pid = getpid();
+        __atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+    }
+    
+    __atomic_fetch_add(&stats->processes, 1, __ATOMIC_RELAXED);
+}
+
+// Область LD_PRELOAD (STFU_SCOPE=all|target|depth:N|names:a,b от stfu
+// --preload-scope). Глубина процесса приходит в STFU_DEPTH: exec без fork её
+// сохраняет, потомок получает +1. Потомку вне области exec*/posix_spawn
+// передают окружение без shim, и его процессы shim уже не загружают
+static struct {
+    int active;             // 0 - all: обёртки exec* ничего не меняют
+    int depth;
+    int max_depth;          // Глубина, до которой shim загружается всегда
+    pid_t pid;              // exec в этом процессе - замена образа, не потомок
+    char *names;            // ",a,b," - имена, которым shim нужен на любой глубине
+    char self[PATH_MAX];    // Путь shim, как он записан в LD_PRELOAD
+} scope;
+
+static void scope_load(void) {
+    const char * const policy = getenv("STFU_SCOPE");
+    if (__builtin_expect(!policy || !*policy || strcmp(policy, "all") == 0, 1)) return;
+    
+    if (strcmp(policy, "target") == 0) {
+        scope.max_depth = 0;
+    } else if (strncmp(policy, "depth:", 6) == 0) {
+        scope.max_depth = atoi(policy + 6);
+    } else if (strncmp(policy, "names:", 6) == 0) {
+        scope.max_depth = 0;
+        const size_t len = strlen(policy + 6);
+        if (!(scope.names = malloc(len + 3))) return;
+        scope.names[0] = ',';
+        memcpy(scope.names + 1, policy + 6, len);
+        memcpy(scope.names + 1 + len, ",", 2);
+    } else {
+        return;
+    }
+    
+    Dl_info info;
+    if (!dladdr((void*)scope_load, &info) || !info.dli_fname ||
+        snprintf(scope.self, sizeof(scope.self), "%s", info.dli_fname) >= (int)sizeof(scope.self)) return;
+    
+    const char * const depth = getenv("STFU_DEPTH");
+    scope.depth = depth ? atoi(depth) : 0;
+    scope.pid = getpid();
+    scope.active = 1;
+}
+
+static int scope_match(const char * const path) {
+    if (!scope.names || !path) return 0;
+    
+    const char * const slash = strrchr(path, '/');
+    const char * const name = slash ? slash + 1 : path;
+    const size_t len = strlen(name);
+    if (!len) return 0;
+    
+    for (const char *p = strstr(scope.names, name); p; p = strstr(p + 1, name)) {
+        if (p[-1] == ',' && p[len] == ',') return 1;
+    }
+    return 0;
+}
+
+// Число переменных окружения и длина строки LD_PRELOAD: размеры буферов scope_env
+static size_t scope_count(char * const envp[], size_t * const preload_len) {
+    size_t n = 0;
+    for (; envp && envp[n]; ++n) {
+        if (strncmp(envp[n], "LD_PRELOAD=", 11) == 0) *preload_len = strlen(envp[n]);
+    }
+    return n;
+}
+
+// Окружение нового образа в out (scope_count + 2 элемента): STFU_DEPTH в
+// области, LD_PRELOAD без shim - вне её. Строки пишутся в depth_var и
+// preload_var: после vfork куча недоступна
+static char** scope_env(const char * const path, const int spawn, char * const envp[], char ** const out,
+                        char * const depth_var, char * const preload_var) {
+    const int depth = spawn || getpid() != scope.pid ? scope.depth + 1 : scope.depth;
+    const int inside = depth <= scope.max_depth || scope_match(path);
+    const size_t self_len = strlen(scope.self);
+    size_t n = 0;
+    
+    for (size_t i = 0; envp && envp[i]; ++i) {
+        if (strncmp(envp[i], "STFU_DEPTH=", 11) == 0) continue;
+        if (inside || strncmp(envp[i], "LD_PRELOAD=", 11) != 0) {
+            out[n++] = envp[i];
+            continue;
+        }
+        
+        // Остальные preload библиотеки остаются; разделители - ':' и пробелы
+        char *w = stpcpy(preload_var, "LD_PRELOAD=");
+        const char *p = envp[i] + 11;
+        while (*p) {
+            const size_t len = strcspn(p, ": \t");
+            if (len && !(len == self_len && strncmp(p, scope.self, len) == 0)) {
+                if (w[-1] != '=') *w++ = ':';
+                w = mempcpy(w, p, len);
+            }
+            p += len;
+            if (*p) ++p;
+        }
+        *w = '\0';
+        if (w[-1] != '=') out[n++] = preload_var;
+    }
+    
+    if (inside) {
+        sprintf(depth_var, "STFU_DEPTH=%d", depth);
+        out[n++] = depth_var;
+    }
+    out[n] = NULL;
+    return out;
+}
+
+// Буферы scope_env на стеке вызывающей обёртки
+#define SCOPE_ENV(path, spawn, envp) \
+    size_t preload_len_ = 0; \
+    const size_t count_ = scope.active ? scope_count(envp, &preload_len_) : 0; \
+    char *env_[count_ + 2]; \
+    char depth_[32]; \
+    char preload_var_[preload_len_ + 1]; \
+    char * const * const envp_ = scope.active ? scope_env(path, spawn, envp, env_, depth_, preload_var_) : (envp)
+
+// Событие трассировки в формате stfu (trace-event JSON, одна строка - один write)
+static void trace_handoff(const char * const env, const struct timespec * const start) {
+    const int fd = atoi(env);
+    unsetenv("STFU_TRACE_FD");
+    
+    struct stat st;
+    if (fd < 3 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return;
+    
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const long long ts = start->tv_sec * 1000000000LL + start->tv_nsec;
+    const long long dur = (end.tv_sec - start->tv_sec) * 1000000000LL + end.tv_nsec - start->tv_nsec;
+    
+    char line[1024];
+    int len = snprintf(line, sizeof(line),
+                       "{\"name\":\"shim_init\",\"cat\":\"shim\",\"ph\":\"X\",\"ts\":%lld.%03lld,\"dur\":%lld.%03lld,"
+                       "\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":\"",
+                       ts / 1000, ts % 1000, dur / 1000, dur % 1000, getpid(), (int)syscall(SYS_gettid));
+    for (const unsigned char *p = (const unsigned char*)program_invocation_name; *p && len < (int)sizeof(line) - 16; ++p) {
+        if (*p == '"' || *p == '\\') line[len++] = '\\';
+        if (*p < 0x20) len += sprintf(line + len, "\\u%04x", *p);
+        else line[len++] = *p;
+    }
+    len += sprintf(line + len, "\"}},\n");
+    
+    if (write(fd, line, len) != len) {}
+    close(fd);
+}
+
+#define REAL(name) real_##name = dlsym(RTLD_NEXT, #name)
+
+static void stfu_setup(void);
+
+__attribute__((constructor)) static void stfu_init(void) {
+    static int initialized = 0;
+    if (initialized) return;
+    initialized = 1;
+    
+    // Без трассировки - один getenv
+    const char * const trace = getenv("STFU_TRACE_FD");
+    struct timespec start;
+    if (__builtin_expect(trace != NULL, 0)) clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    stfu_setup();
+    
+    if (__builtin_expect(trace != NULL, 0)) trace_handoff(trace, &start);
+}
+
+static void stfu_setup(void) {
+    REAL(access); REAL(faccessat);
+    REAL(stat); REAL(lstat); REAL(fstatat);
+    REAL(stat64); REAL(lstat64); REAL(fstatat64); REAL(statx);
+    REAL(__xstat); REAL(__lxstat); REAL(__fxstatat);
+    REAL(open); REAL(open64); REAL(openat); REAL(openat64);
+    REAL(__open_2); REAL(__open64_2); REAL(__openat_2); REAL(__openat64_2);
+    REAL(fopen); REAL(fopen64); REAL(opendir);
+    REAL(getpwuid); REAL(getpwuid_r); REAL(getpwnam); REAL(getpwnam_r);
+    REAL(getgrgid); REAL(getgrgid_r); REAL(getgrnam); REAL(getgrnam_r);
+    REAL(execve); REAL(execvpe); REAL(posix_spawn); REAL(posix_spawnp);
+    
+    identity_load();
+    scope_load();
+    stats_attach();
+    
+    // Правила по умолчанию (snap Firefox) приходят от stfu из профиля [default]
+    const char * const env = getenv("STFU_RULES");
+    if (!env || !*env) return;
+    
+    char * const text = strdup(env);
+    if (!text) return;
+    
+    // Узлов не больше суммарной длины префиксов, правил - не больше ';' + 1
+    size_t max_rules = 1;
+    for (const char *p = text; *p; ++p) max_rules += *p == ';' || *p == '\n';
+    
+    rules = malloc(max_rules * sizeof(rule_t));
+    trie = calloc(strlen(text) + 1, sizeof(trie_node_t));
+    if (!rules || !trie) {
+        memset(first_byte, 0, sizeof(first_byte));
+        return;
+    }
+    
+    trie[0].rule = -1;
+    trie_size = 1;
+    compile_rules(text, getenv("STFU_CUSTOM_HOME"));
+}
+
+// Самое длинное правило, префикс которого совпадает с путём по границе компонента
+static int match_rule(const char * const path) {
+    int best = -1, node = 0;
+    
+    for (const unsigned char *p = (const unsigned char*)path; *p; ++p) {
+        node = trie_child(node, *p);
+        if (!node) break;
+        if (trie[node].rule >= 0 && (*p == '/' || p[1] == '/' || p[1] == '\0')) best = trie[node].rule;
+    }
+    
+    return best;
+}
+
+static const char* apply_rule(const char * const path, char * const buf) {
+    const int r = match_rule(path);
+    if (r < 0 || rules[r].kind == RULE_PASS) return path;
+    
+    if (rules[r].kind == RULE_DENY) {
+        errno = ENOENT;
+        return NULL;
+    }
+    
+    // Остаток пути после префикса всегда начинается с '/' или пуст
+    const char *rest = path + rules[r].prefix_len;
+    if (rules[r].prefix_len == 1) --rest;
+    
+    const size_t rest_len = strlen(rest);
+    if (rules[r].target_len + rest_len >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    
+    memcpy(buf, rules[r].target, rules[r].target_len);
+    memcpy(buf + rules[r].target_len, rest, rest_len + 1);
+    return buf;
+}
+
+// Путь после правил: исходный, переписанный в buf или NULL (errno задан).
+// Путь без правил стоит одного сравнения и одной загрузки из таблицы
+static inline const char* rule_path(const char * const path, char * const buf) {
+    if (__builtin_expect(!path || path[0] != '/' || !first_byte[(unsigned char)path[1]], 1)) return path;
+    return apply_rule(path, buf);
+}
+
+// Начало перехватчика: счётчик, и вызов до конструктора (из конструкторов
+// других библиотек) тоже работает
+#define HOOK_ENTER(name, fail) \
+    const long long start_ = stats_enter(SYM_##name); \
+    if (__builtin_expect(!real_##name, 0)) stfu_init(); \
+    if (!real_##name) { \
+        errno = ENOSYS; \
+        stats_leave(SYM_##name, start_); \
+        return fail; \
+    }
+
+#define HOOK_RETURN(name, expr) do { \
+        const __typeof__(expr) ret_ = (expr); \
+        stats_leave(SYM_##name, start_); \
+        return ret_; \
+    } while (0)
+
+#define RULE_PATH(name, path, fail) \
+    char buf_[PATH_MAX]; \
+    const char * const path_ = rule_path(path, buf_); \
+    if (!path_) HOOK_RETURN(name, fail)
+
+// Режим open() передаётся только вместе с O_CREAT или O_TMPFILE
+#define OPEN_MODE(flags, last) \
+    mode_t mode_ = 0; \
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) { \
+        va_list ap_; \
+        va_start(ap_, last); \
+        mode_ = va_arg(ap_, mode_t); \
+        va_end(ap_); \
+    }
+
+// Личность из неизменяемого блока: время не замеряется, только вызовы.
+// До конструктора (из конструкторов других библиотек) блок ещё пуст
+#define IDENTITY(type, name, value) \
+    type name(void) { \
+        stats_leave(SYM_##name, stats_enter(SYM_##name)); \
+        if (__builtin_expect(!identity.pw.pw_name, 0)) stfu_init(); \
+        return value; \
+    }
+
+IDENTITY(uid_t, getuid, identity.uid)
+IDENTITY(uid_t, geteuid, identity.uid)
+IDENTITY(gid_t, getgid, identity.gid)
+IDENTITY(gid_t, getegid, identity.gid)
+IDENTITY(char*, getlogin, identity.name)
+
+#define IDENTITY_RES(type, name, value) \
+    int name(type *r, type *e, type *s) { \
+        stats_leave(SYM_##name, stats_enter(SYM_##name)); \
+        if (__builtin_expect(!identity.pw.pw_name, 0)) stfu_init(); \
+        *r = *e = *s = value; \
+        return 0; \
+    }
+
+IDENTITY_RES(uid_t, getresuid, identity.uid)
+IDENTITY_RES(gid_t, getresgid, identity.gid)
+
+int getgroups(int size, gid_t list[]) {
+    stats_leave(SYM_getgroups, stats_enter(SYM_getgroups));
+    if (__builtin_expect(!identity.pw.pw_name, 0)) stfu_init();
+    
+    if (size == 0) return identity.ngroups;
+    if (size < identity.ngroups) {
+        errno = EINVAL;
+        return -1;
+    }
+    
+    memcpy(list, identity.groups, identity.ngroups * sizeof(gid_t));
+    return identity.ngroups;
+}
+
+int getlogin_r(char *buf, size_t size) {
+    stats_leave(SYM_getlogin_r, stats_enter(SYM_getlogin_r));
+    if (__builtin_expect(!identity.pw.pw_name, 0)) stfu_init();
+    
+    const size_t len = strlen(identity.name) + 1;
+    if (len > size) return ERANGE;
+    
+    memcpy(buf, identity.name, len);
+    return 0;
+}
+
+// Записи passwd/group: свой пользователь и настоящий (root) - поддельная
+// запись, остальные - как есть
+struct passwd *getpwuid(uid_t uid) {
+    HOOK_ENTER(getpwuid, NULL);
+    HOOK_RETURN(getpwuid, identity_user(uid) ? &identity.pw : real_getpwuid(uid));
+}
+
+struct passwd *getpwnam(const char *name) {
+    HOOK_ENTER(getpwnam, NULL);
+    HOOK_RETURN(getpwnam, strcmp(name, identity.name) == 0 ? &identity.pw : real_getpwnam(name));
+}
+
+int getpwuid_r(uid_t uid, struct passwd *pwd, char *buf, size_t buflen, struct passwd **result) {
+    HOOK_ENTER(getpwuid_r, ENOSYS);
+    HOOK_RETURN(getpwuid_r, identity_user(uid) ? identity_passwd_r(pwd, buf, buflen, result) :
+                                                 real_getpwuid_r(uid, pwd, buf, buflen, result));
+}
+
+int getpwnam_r(const char *name, struct passwd *pwd, char *buf, size_t buflen, struct passwd **result) {
+    HOOK_ENTER(getpwnam_r, ENOSYS);
+    HOOK_RETURN(getpwnam_r, strcmp(name, identity.name) == 0 ?
+                            identity_passwd_r(pwd, buf, buflen, result) :
+                            real_getpwnam_r(name, pwd, buf, buflen, result));
+}
+
+struct group *getgrgid(gid_t gid) {
+    HOOK_ENTER(getgrgid, NULL);
+    HOOK_RETURN(getgrgid, identity_group(gid) ? &identity.gr : real_getgrgid(gid));
+}
+
+struct group *getgrnam(const char *name) {
+    HOOK_ENTER(getgrnam, NULL);
+    HOOK_RETURN(getgrnam, strcmp(name, identity.name) == 0 ? &identity.gr : real_getgrnam(name));
+}
+
+int getgrgid_r(gid_t gid, struct group *grp, char *buf, size_t buflen, struct group **result) {
+    HOOK_ENTER(getgrgid_r, ENOSYS);
+    HOOK_RETURN(getgrgid_r, identity_group(gid) ? identity_group_r(grp, buf, buflen, result) :
+                                                  real_getgrgid_r(gid, grp, buf, buflen, result));
+}
+
+int getgrnam_r(const char *name, struct group *grp, char *buf, size_t buflen, struct group **result) {
+    HOOK_ENTER(getgrnam_r, ENOSYS);
+    HOOK_RETURN(getgrnam_r, strcmp(name, identity.name) == 0 ?
+                            identity_group_r(grp, buf, buflen, result) :
+                            real_getgrnam_r(name, grp, buf, buflen, result));
+}
+
+int access(const char *path, int mode) {
+    HOOK_ENTER(access, -1);
+    RULE_PATH(access, path, -1);
+    HOOK_RETURN(access, real_access(path_, mode));
+}
+
+int faccessat(int dirfd, const char *path, int mode, int flags) {
+    HOOK_ENTER(faccessat, -1);
+    RULE_PATH(faccessat, path, -1);
+    HOOK_RETURN(faccessat, real_faccessat(dirfd, path_, mode, flags));
+}
+
+int stat(const char *path, struct stat *st) {
+    HOOK_ENTER(stat, -1);
+    RULE_PATH(stat, path, -1);
+    HOOK_RETURN(stat, real_stat(path_, st));
+}
+
+int lstat(const char *path, struct stat *st) {
+    HOOK_ENTER(lstat, -1);
+    RULE_PATH(lstat, path, -1);
+    HOOK_RETURN(lstat, real_lstat(path_, st));
+}
+
+int fstatat(int dirfd, const char *path, struct stat *st, int flags) {
+    HOOK_ENTER(fstatat, -1);
+    RULE_PATH(fstatat, path, -1);
+    HOOK_RETURN(fstatat, real_fstatat(dirfd, path_, st, flags));
+}
+
+int stat64(const char *path, struct stat64 *st) {
+    HOOK_ENTER(stat64, -1);
+    RULE_PATH(stat64, path, -1);
+    HOOK_RETURN(stat64, real_stat64(path_, st));
+}
+
+int lstat64(const char *path, struct stat64 *st) {
+    HOOK_ENTER(lstat64, -1);
+    RULE_PATH(lstat64, path, -1);
+    HOOK_RETURN(lstat64, real_lstat64(path_, st));
+}
+
+int fstatat64(int dirfd, const char *path, struct stat64 *st, int flags) {
+    HOOK_ENTER(fstatat64, -1);
+    RULE_PATH(fstatat64, path, -1);
+    HOOK_RETURN(fstatat64, real_fstatat64(dirfd, path_, st, flags));
+}
+
+int statx(int dirfd, const char *path, int flags, unsigned int mask, struct statx *st) {
+    HOOK_ENTER(statx, -1);
+    RULE_PATH(statx, path, -1);
+    HOOK_RETURN(statx, real_statx(dirfd, path_, flags, mask, st));
+}
+
+// Программы, собранные со старой glibc (до 2.33), вызывают stat через __xstat;
+// без старых символов в libc вызов уходит в stat
+int __xstat(int ver, const char *path, struct stat *st);
+int __lxstat(int ver, const char *path, struct stat *st);
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *st, int flags);
+
+int __xstat(int ver, const char *path, struct stat *st) {
+    const long long start_ = stats_enter(SYM___xstat);
+    if (__builtin_expect(!real_stat, 0)) stfu_init();
+    RULE_PATH(__xstat, path, -1);
+    HOOK_RETURN(__xstat, real___xstat ? real___xstat(ver, path_, st) : real_stat(path_, st));
+}
+
+int __lxstat(int ver, const char *path, struct stat *st) {
+    const long long start_ = stats_enter(SYM___lxstat);
+    if (__builtin_expect(!real_lstat, 0)) stfu_init();
+    RULE_PATH(__lxstat, path, -1);
+    HOOK_RETURN(__lxstat, real___lxstat ? real___lxstat(ver, path_, st) : real_lstat(path_, st));
+}
+
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *st, int flags) {
+    const long long start_ = stats_enter(SYM___fxstatat);
+    if (__builtin_expect(!real_fstatat, 0)) stfu_init();
+    RULE_PATH(__fxstatat, path, -1);
+    HOOK_RETURN(__fxstatat, real___fxstatat ? real___fxstatat(ver, dirfd, path_, st, flags)
+                                            : real_fstatat(dirfd, path_, st, flags));
+}
+
+int open(const char *path, int flags, ...) {
+    OPEN_MODE(flags, flags);
+    HOOK_ENTER(open, -1);
+    RULE_PATH(open, path, -1);
+    HOOK_RETURN(open, real_open(path_, flags, mode_));
+}
+
+int open64(const char *path, int flags, ...) {
+    OPEN_MODE(flags, flags);
+    HOOK_ENTER(open64, -1);
+    RULE_PATH(open64, path, -1);
+    HOOK_RETURN(open64, real_open64(path_, flags, mode_));
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    OPEN_MODE(flags, flags);
+    HOOK_ENTER(openat, -1);
+    RULE_PATH(openat, path, -1);
+    HOOK_RETURN(openat, real_openat(dirfd, path_, flags, mode_));
+}
+
+int openat64(int dirfd, const char *path, int flags, ...) {
+    OPEN_MODE(flags, flags);
+    HOOK_ENTER(openat64, -1);
+    RULE_PATH(openat64, path, -1);
+    HOOK_RETURN(openat64, real_openat64(dirfd, path_, flags, mode_));
+}
+
+// Варианты open из _FORTIFY_SOURCE
+int __open_2(const char *path, int flags) {
+    HOOK_ENTER(__open_2, -1);
+    RULE_PATH(__open_2, path, -1);
+    HOOK_RETURN(__open_2, real___open_2(path_, flags));
+}
+
+int __open64_2(const char *path, int flags) {
+    HOOK_ENTER(__open64_2, -1);
+    RULE_PATH(__open64_2, path, -1);
+    HOOK_RETURN(__open64_2, real___open64_2(path_, flags));
+}
+
+int __openat_2(int dirfd, const char *path, int flags) {
+    HOOK_ENTER(__openat_2, -1);
+    RULE_PATH(__openat_2, path, -1);
+    HOOK_RETURN(__openat_2, real___openat_2(dirfd, path_, flags));
+}
+
+int __openat64_2(int dirfd, const char *path, int flags) {
+    HOOK_ENTER(__openat64_2, -1);
+    RULE_PATH(__openat64_2, path, -1);
+    HOOK_RETURN(__openat64_2, real___openat64_2(dirfd, path_, flags));
+}
+
+FILE *fopen(const char *path, const char *mode) {
+    HOOK_ENTER(fopen, NULL);
+    RULE_PATH(fopen, path, (FILE*)NULL);
+    HOOK_RETURN(fopen, real_fopen(path_, mode));
+}
+
+FILE *fopen64(const char *path, const char *mode) {
+    HOOK_ENTER(fopen64, NULL);
+    RULE_PATH(fopen64, path, (FILE*)NULL);
+    HOOK_RETURN(fopen64, real_fopen64(path_, mode));
+}
+
+DIR *opendir(const char *path) {
+    HOOK_ENTER(opendir, NULL);
+    RULE_PATH(opendir, path, (DIR*)NULL);
+    HOOK_RETURN(opendir, real_opendir(path_));
+}
+
+// exec* и posix_spawn: окружение по области LD_PRELOAD. До exec счётчики
+// потока сбрасываются в сегмент - деструкторы при exec не вызываются.
+// execl* собирают argv на стеке и идут через те же обёртки
+int execve(const char *path, char *const argv[], char *const envp[]) {
+    HOOK_ENTER(execve, -1);
+    SCOPE_ENV(path, 0, envp);
+    stats_leave(SYM_execve, start_);
+    stats_flush();
+    return real_execve(path, argv, envp_);
+}
+
+int execvpe(const char *file, char *const argv[], char *const envp[]) {
+    HOOK_ENTER(execvpe, -1);
+    SCOPE_ENV(file, 0, envp);
+    stats_leave(SYM_execvpe, start_);
+    stats_flush();
+    return real_execvpe(file, argv, envp_);
+}
+
+int execv(const char *path, char *const argv[]) {
+    stats_leave(SYM_execv, stats_enter(SYM_execv));
+    return execve(path, argv, environ);
+}
+
+int execvp(const char *file, char *const argv[]) {
+    stats_leave(SYM_execvp, stats_enter(SYM_execvp));
+    return execvpe(file, argv, environ);
+}
+
+// Аргументы execl* до NULL; у execle за NULL следует envp
+#define EXECL_ARGV(arg) \
+    va_list ap_; \
+    size_t argc_ = 1; \
+    va_start(ap_, arg); \
+    while (va_arg(ap_, char*)) ++argc_; \
+    va_end(ap_); \
+    char *argv_[argc_ + 1]; \
+    argv_[0] = (char*)arg; \
+    va_start(ap_, arg); \
+    for (size_t i_ = 1; i_ <= argc_; ++i_) argv_[i_] = va_arg(ap_, char*)
+
+int execl(const char *path, const char *arg, ...) {
+    stats_leave(SYM_execl, stats_enter(SYM_execl));
+    EXECL_ARGV(arg);
+    va_end(ap_);
+    return execve(path, argv_, environ);
+}
+
+int execlp(const char *file, const char *arg, ...) {
+    stats_leave(SYM_execlp, stats_enter(SYM_execlp));
+    EXECL_ARGV(arg);
+    va_end(ap_);
+    return execvpe(file, argv_, environ);
+}
+
+int execle(const char *path, const char *arg, ...) {
+    stats_leave(SYM_execle, stats_enter(SYM_execle));
+    EXECL_ARGV(arg);
+    char * const * const envp = va_arg(ap_, char* const*);
+    va_end(ap_);
+    return execve(path, argv_, envp);
+}
+
+int posix_spawn(pid_t *pid, const char *path, const posix_spawn_file_actions_t *actions,
+                const posix_spawnattr_t *attr, char *const argv[], char *const envp[]) {
+    HOOK_ENTER(posix_spawn, ENOSYS);
+    SCOPE_ENV(path, 1, envp);
+    HOOK_RETURN(posix_spawn, real_posix_spawn(pid, path, actions, attr, argv, envp_));
+}
+
+int posix_spawnp(pid_t *pid, const char *file, const posix_spawn_file_actions_t *actions,
+                 const posix_spawnattr_t *attr, char *const argv[], char *const envp[]) {
+    HOOK_ENTER(posix_spawnp, ENOSYS);
+    SCOPE_ENV(file, 1, envp);
+    HOOK_RETURN(posix_spawnp, real_posix_spawnp(pid, file, actions, attr, argv, envp_));
+}
@@ -0,0 +1,36 @@
+#ifndef STFU_STATS_H
+#define STFU_STATS_H
+
+// Сегмент статистики shim в /dev/shm/stfu-stats-<сессия>: одна сессия на
+// запущенное дерево процессов. Пишет stfu_fake.c, читает stfu --stats.
+// Файл встраивается в исходник shim перед stfu_fake.c, поэтому обходится
+// без системных заголовков.
+#define STATS_MAGIC 0x53544653u     // "SFTS"
+#define STATS_VERSION 1
+#define STATS_PREFIX "stfu-stats-"
+#define STATS_MAX_SYMBOLS 64
+#define STATS_NAME_MAX 24
+#define STATS_BUCKETS 32            // Корзина b: время в [2^(b-1), 2^b) нс
+#define STATS_SAMPLE 64             // Время измеряется у каждого 64-го вызова символа в потоке
+
+// Счётчики символа на отдельной кэш-линии: потоки пишут атомарно без блокировок
+typedef struct {
+    char name[STATS_NAME_MAX];
+    unsigned long long calls;
+    unsigned long long sampled;
+    unsigned long long total_ns;    // Сумма по замеренным вызовам
+    unsigned long long hist[STATS_BUCKETS];
+} __attribute__((aligned(64))) stats_symbol_t;
+
+typedef struct {
+    unsigned int magic;             // Записывается последним
+    unsigned int version;
+    unsigned int symbols;
+    unsigned int sample;
+    unsigned long long created;     // Секунды с эпохи
+    unsigned int processes;         // Процессов, подключившихся к сегменту
+    int root_pid;
+    stats_symbol_t symbol[STATS_MAX_SYMBOLS];
+} stats_segment_t;
+
+#endif